@@ -0,0 +1,92 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+
+
+/** @file SDL_sixel.h
+ *  Include file for SDL sixel video driver specific functions
+ */
+
+#ifndef _SDL_sixel_h
+#define _SDL_sixel_h
+
+#include "SDL_stdinc.h"
+#include "SDL_error.h"
+
+#include "begin_code.h"
+/* Set up for C function definitions, even when using C++ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Counters kept by the sixel video driver since the video mode was set or
+ * the counters were last reset.  Times are in microseconds and add up the
+ * time spent in each stage over all frames.
+ *
+ * The copy stage only runs with SDL_SIXEL_ASYNC.  Quantizing is timed on its
+ * own by the built in encoder; with libsixel it is part of the encode time.
+ * Scaling to the terminal size is also part of the encode time.  Encoding
+ * threads add up their time, so quantize_us may exceed encode_us.
+ */
+typedef struct SDL_SixelStats {
+	Uint32 frames;			/**< Frames sent to the terminal */
+	Uint32 frames_dropped;		/**< Frames merged into a later one */
+	Uint32 rects;			/**< Rectangles encoded */
+	Uint32 effective_fps;		/**< Frames sent over the last second */
+	Uint32 palette_builds;		/**< Adaptive palettes built */
+	Uint32 scrolls;			/**< Scrolls done by the terminal */
+	Uint64 bytes;			/**< Bytes taken by the terminal */
+	Uint32 pending;			/**< Bytes waiting for the terminal */
+	Uint64 copy_us;			/**< Snapshotting frames for the encoder */
+	Uint64 scale_us;		/**< Scaling down to the terminal size */
+	Uint64 diff_us;			/**< Finding and merging changed areas */
+	Uint64 quantize_us;		/**< Mapping pixels to the palette */
+	Uint64 encode_us;		/**< Producing sixel data */
+	Uint64 write_us;		/**< Writing to the terminal */
+	Uint32 latency_us;		/**< Last time from encoding to fully written */
+	Uint32 latency_max_us;		/**< Longest such time */
+} SDL_SixelStats;
+
+/**
+ * Fill in the counters of the sixel video driver.
+ * Returns 0 on success, or -1 if the sixel driver is not in use.
+ *
+ * Setting the SDL_SIXEL_STATS environment variable to a file name, or to
+ * "stderr", makes the driver write a line of per-frame averages there
+ * every second.
+ *
+ * Without the sixel driver built in, this always fails.
+ */
+extern DECLSPEC int SDLCALL SDL_SixelGetStats(SDL_SixelStats *stats);
+
+/**
+ * Set the counters of the sixel video driver back to zero.
+ */
+extern DECLSPEC void SDLCALL SDL_SixelResetStats(void);
+
+/* Ends C function definitions when using C++ */
+#ifdef __cplusplus
+}
+#endif
+#include "close_code.h"
+
+#endif /* _SDL_sixel_h */
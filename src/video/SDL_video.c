@@ -24,6 +24,7 @@
 /* The high-level video driver subsystem */
 
 #include "SDL.h"
+#include "SDL_sixel.h"
 #include "SDL_sysvideo.h"
 #include "SDL_blit.h"
 #include "SDL_pixels_c.h"
@@ -1979,3 +1980,18 @@ int SDL_GetWMInfo (SDL_SysWMinfo *info)
 		return(0);
 	}
 }
+
+#if !SDL_VIDEO_DRIVER_SIXEL
+/*
+ * The counters of the sixel driver, when SDL is built without it
+ */
+int SDL_SixelGetStats(SDL_SixelStats *stats)
+{
+	SDL_SetError("Sixel video driver is not in use");
+	return(-1);
+}
+
+void SDL_SixelResetStats(void)
+{
+}
+#endif /* !SDL_VIDEO_DRIVER_SIXEL */
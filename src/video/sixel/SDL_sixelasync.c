@@ -0,0 +1,221 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+
+#include "SDL_config.h"
+
+/* Asynchronous sixel encoding.
+
+   The mailbox is a classic triple buffer: the application thread fills the
+   "free" slot and swaps it with the "pending" one, the encoder thread swaps
+   the "pending" slot with the one it is "encoding".  A pending frame that
+   has not been picked up yet is simply replaced by the newer one, but its
+   dirty rectangles are carried forward so nothing is lost on screen.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL.h"
+#include "SDL_sixelvideo.h"
+#include "SDL_sixelasync_c.h"
+#include "SDL_sixelrects_c.h"
+#include "SDL_sixelwriter_c.h"
+#include "SDL_sixelpacing_c.h"
+#include "SDL_sixelscroll_c.h"
+
+static int SIXEL_EncoderThread(_THIS)
+{
+	sixel_frame_t *frame;
+	int slot, pending, quit;
+	Uint32 delay;
+	Uint64 start;
+
+	for ( ; ; ) {
+		/* Newer frames replace the pending one until the next is due */
+		if ( SIXEL_fps > 0 && (delay = SIXEL_PaceDelay(this)) > 0 ) {
+			SDL_Delay((delay + 999) / 1000);
+		}
+
+		SDL_mutexP(SIXEL_mailbox_lock);
+		while ( ! SIXEL_frame_ready && ! SIXEL_encoder_quit ) {
+			SDL_CondWait(SIXEL_mailbox_cond, SIXEL_mailbox_lock);
+		}
+		if ( ! SIXEL_frame_ready ) {
+			/* Asked to quit and everything has been drained */
+			SDL_mutexV(SIXEL_mailbox_lock);
+			break;
+		}
+		slot = SIXEL_frame_encoding;
+		SIXEL_frame_encoding = SIXEL_frame_pending;
+		SIXEL_frame_pending = slot;
+		SIXEL_frame_ready = 0;
+		frame = &SIXEL_frames[SIXEL_frame_encoding];
+		SDL_mutexV(SIXEL_mailbox_lock);
+
+		SDL_mutexP(SIXEL_mutex);
+		start = SIXEL_GetMicroseconds();
+		SIXEL_EmitScrolls(this, frame->nscrolls, frame->scrolls);
+		SIXEL_EncodeRects(this, frame->pixels, frame->numrects, frame->rects);
+		pending = SIXEL_FlushWriter(this);
+		SIXEL_PaceEncoded(this, start);
+		SDL_mutexV(SIXEL_mutex);
+
+		/* Let the terminal catch up, newer frames replace this one
+		   in the mailbox meanwhile.  When asked to quit, whatever is
+		   left is up to SIXEL_CloseWriter(), which doesn't wait long. */
+		while ( pending > 0 ) {
+			SIXEL_WaitWriter(this, SIXEL_WRITE_WAIT);
+			SDL_mutexP(SIXEL_mailbox_lock);
+			quit = SIXEL_encoder_quit;
+			SDL_mutexV(SIXEL_mailbox_lock);
+			if ( quit ) {
+				break;
+			}
+			SDL_mutexP(SIXEL_mutex);
+			pending = SIXEL_FlushWriter(this);
+			SDL_mutexV(SIXEL_mutex);
+		}
+	}
+	return(0);
+}
+
+int SIXEL_StartEncoder(_THIS)
+{
+	int i;
+
+	for ( i = 0; i < SIXEL_NUMFRAMES; ++i ) {
+		SIXEL_frames[i].pixels = malloc(SIXEL_w * SIXEL_h * SIXEL_bpp);
+		if ( ! SIXEL_frames[i].pixels ) {
+			SIXEL_StopEncoder(this);
+			SDL_OutOfMemory();
+			return(-1);
+		}
+		SIXEL_frames[i].numrects = 0;
+	}
+	SIXEL_frame_free = 0;
+	SIXEL_frame_pending = 1;
+	SIXEL_frame_encoding = 2;
+	SIXEL_frame_ready = 0;
+	SIXEL_encoder_quit = 0;
+
+	SIXEL_encoder = SDL_CreateThread((int (*)(void *))SIXEL_EncoderThread, this);
+	if ( ! SIXEL_encoder ) {
+		SIXEL_StopEncoder(this);
+		return(-1);
+	}
+	return(0);
+}
+
+void SIXEL_StopEncoder(_THIS)
+{
+	int i;
+
+	if ( SIXEL_encoder ) {
+		SDL_mutexP(SIXEL_mailbox_lock);
+		SIXEL_encoder_quit = 1;
+		SDL_CondSignal(SIXEL_mailbox_cond);
+		SDL_mutexV(SIXEL_mailbox_lock);
+		SDL_WaitThread(SIXEL_encoder, NULL);
+		SIXEL_encoder = NULL;
+	}
+	for ( i = 0; i < SIXEL_NUMFRAMES; ++i ) {
+		if ( SIXEL_frames[i].pixels ) {
+			free(SIXEL_frames[i].pixels);
+			SIXEL_frames[i].pixels = NULL;
+		}
+	}
+}
+
+void SIXEL_PostFrame(_THIS, int numrects, SDL_Rect *rects)
+{
+	sixel_frame_t *frame, *pending;
+	SDL_Rect *rect, *merged, screen;
+	int i, n, y, slot, dropped = 0;
+	int pitch = SIXEL_w * SIXEL_bpp;
+	Uint64 start, copy_us;
+
+	SDL_mutexP(SIXEL_mailbox_lock);
+	frame = &SIXEL_frames[SIXEL_frame_free];
+	frame->numrects = 0;
+	frame->nscrolls = 0;
+	if ( SIXEL_frame_ready ) {
+		/* The encoder didn't get to the pending frame, drop it */
+		pending = &SIXEL_frames[SIXEL_frame_pending];
+		dropped = 1;
+		SIXEL_AddRects(frame->rects, &frame->numrects,
+		               pending->numrects, pending->rects);
+		SIXEL_AddScrolls(this, frame->scrolls, &frame->nscrolls,
+		                 pending->nscrolls, pending->scrolls);
+
+		/* Its cells get scrolled before they are shown */
+		SIXEL_ScrollRects(this, SIXEL_nscrolls, SIXEL_scrolls,
+		                  frame->numrects, frame->rects);
+	}
+	if ( SIXEL_AddScrolls(this, frame->scrolls, &frame->nscrolls,
+	                      SIXEL_nscrolls, SIXEL_scrolls) < 0 ) {
+		/* Too many scrolls piled up, redraw everything instead */
+		frame->nscrolls = 0;
+		screen.x = 0;
+		screen.y = 0;
+		screen.w = SIXEL_w;
+		screen.h = SIXEL_h;
+		SIXEL_AddRects(frame->rects, &frame->numrects, 1, &screen);
+	}
+	SIXEL_nscrolls = 0;
+	SIXEL_AddRects(frame->rects, &frame->numrects, numrects, rects);
+	if ( SIXEL_frame_ready ) {
+		/* The rectangles of both frames may well overlap */
+		n = SIXEL_CoalesceRects(this, frame->numrects, frame->rects, &merged);
+		SDL_memmove(frame->rects, merged, n * sizeof(*merged));
+		frame->numrects = n;
+	}
+
+	/* Snapshot the dirty regions */
+	start = SIXEL_GetMicroseconds();
+	for ( i = 0; i < frame->numrects; ++i ) {
+		rect = &frame->rects[i];
+		if ( rect->x == 0 && rect->w == SIXEL_w ) {
+			memcpy(frame->pixels + rect->y * pitch,
+			       SIXEL_buffer + rect->y * pitch, rect->h * pitch);
+		} else {
+			for ( y = rect->y; y < rect->y + rect->h; ++y ) {
+				memcpy(frame->pixels + y * pitch + rect->x * SIXEL_bpp,
+				       SIXEL_buffer + y * pitch + rect->x * SIXEL_bpp,
+				       rect->w * SIXEL_bpp);
+			}
+		}
+	}
+	copy_us = SIXEL_GetMicroseconds() - start;
+
+	slot = SIXEL_frame_pending;
+	SIXEL_frame_pending = SIXEL_frame_free;
+	SIXEL_frame_free = slot;
+	SIXEL_frame_ready = 1;
+	SDL_CondSignal(SIXEL_mailbox_cond);
+	SDL_mutexV(SIXEL_mailbox_lock);
+
+	/* The statistics belong to the output lock, never hold both */
+	SDL_mutexP(SIXEL_mutex);
+	SIXEL_frames_dropped += dropped;
+	SIXEL_stats.copy_us += copy_us;
+	SDL_mutexV(SIXEL_mutex);
+}
@@ -0,0 +1,32 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+
+
+#include "SDL_sixelvideo.h"
+
+/* Functions exported by SDL_sixelasync.c to the rest of the sixel driver.
+   The encoder thread owns the terminal output while it is running, the
+   application thread only snapshots dirty regions into the mailbox.
+*/
+extern int SIXEL_StartEncoder(_THIS);
+extern void SIXEL_StopEncoder(_THIS);
+extern void SIXEL_PostFrame(_THIS, int numrects, SDL_Rect *rects);
@@ -0,0 +1,174 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+
+#include "SDL_config.h"
+
+/* Capture of what the application hands to the sixel driver.
+
+   With SDL_SIXEL_CAPTURE set to a file name, every update is recorded
+   along with the pixels it covers, so that a problem seen on some
+   terminal can be reproduced and measured offline with
+   test/testsixelreplay.  The file starts with the 8 bytes "SIXELCAP",
+   then come records made of a type byte and 32-bit fields in host byte
+   order:
+
+     'M' w h bpp                    a video mode was set
+     'G' pixel_w pixel_h cols rows  the terminal reported its size
+     'P' first ncolors              followed by ncolors RGB triplets
+     'F' time_lo time_hi numrects   followed by numrects times x y w h,
+                                    then the pixels of every rectangle
+                                    row by row
+
+   Frame times are in microseconds since the capture started.  Geometry
+   is recorded before the first frame that sees it.
+*/
+
+#include <stdio.h>
+
+#include "SDL.h"
+#include "SDL_sixelvideo.h"
+#include "SDL_sixelcapture_c.h"
+
+#define SIXEL_CAPTURE_MAGIC "SIXELCAP"
+
+static void SIXEL_CaptureRecord(_THIS, int type, const Uint32 *fields, int n)
+{
+	fputc(type, SIXEL_capture);
+	fwrite(fields, sizeof(*fields), n, SIXEL_capture);
+}
+
+/* Give up on the capture if the disk filled up or such */
+static void SIXEL_CaptureCheck(_THIS)
+{
+	if ( ferror(SIXEL_capture) ) {
+		SDL_SetError("Couldn't write sixel capture");
+		SIXEL_CloseCapture(this);
+	}
+}
+
+void SIXEL_OpenCapture(_THIS)
+{
+	const char *envr = SDL_getenv("SDL_SIXEL_CAPTURE");
+
+	SIXEL_capture = NULL;
+	if ( ! envr || ! *envr ) {
+		return;
+	}
+	SIXEL_capture = fopen(envr, "wb");
+	if ( ! SIXEL_capture ) {
+		return;
+	}
+	fwrite(SIXEL_CAPTURE_MAGIC, 1, 8, SIXEL_capture);
+	SIXEL_capture_start = SIXEL_GetMicroseconds();
+	SDL_memset(SIXEL_capture_geometry, 0, sizeof(SIXEL_capture_geometry));
+	SIXEL_CaptureCheck(this);
+}
+
+void SIXEL_CloseCapture(_THIS)
+{
+	if ( SIXEL_capture ) {
+		fclose(SIXEL_capture);
+		SIXEL_capture = NULL;
+	}
+}
+
+void SIXEL_CaptureMode(_THIS)
+{
+	Uint32 fields[3];
+
+	if ( ! SIXEL_capture ) {
+		return;
+	}
+	fields[0] = SIXEL_w;
+	fields[1] = SIXEL_h;
+	fields[2] = SIXEL_bpp * 8;
+	SIXEL_CaptureRecord(this, 'M', fields, 3);
+
+	/* The terminal will be asked again */
+	SDL_memset(SIXEL_capture_geometry, 0, sizeof(SIXEL_capture_geometry));
+	SIXEL_CaptureCheck(this);
+}
+
+void SIXEL_CapturePalette(_THIS, int firstcolor, int ncolors, SDL_Color *colors)
+{
+	Uint32 fields[2];
+	Uint8 rgb[3];
+	int i;
+
+	if ( ! SIXEL_capture ) {
+		return;
+	}
+	fields[0] = firstcolor;
+	fields[1] = ncolors;
+	SIXEL_CaptureRecord(this, 'P', fields, 2);
+	for ( i = 0; i < ncolors; ++i ) {
+		rgb[0] = colors[i].r;
+		rgb[1] = colors[i].g;
+		rgb[2] = colors[i].b;
+		fwrite(rgb, 1, 3, SIXEL_capture);
+	}
+	SIXEL_CaptureCheck(this);
+}
+
+void SIXEL_CaptureFrame(_THIS, int numrects, SDL_Rect *rects)
+{
+	Uint32 fields[4];
+	Uint64 now;
+	int i, y;
+	int pitch = SIXEL_w * SIXEL_bpp;
+	SDL_Rect *rect;
+
+	if ( ! SIXEL_capture || numrects == 0 ) {
+		return;
+	}
+
+	fields[0] = SIXEL_pixel_w;
+	fields[1] = SIXEL_pixel_h;
+	fields[2] = SIXEL_cell_w;
+	fields[3] = SIXEL_cell_h;
+	if ( SDL_memcmp(fields, SIXEL_capture_geometry, sizeof(fields)) != 0 ) {
+		SIXEL_CaptureRecord(this, 'G', fields, 4);
+		SDL_memcpy(SIXEL_capture_geometry, fields, sizeof(fields));
+	}
+
+	now = SIXEL_GetMicroseconds() - SIXEL_capture_start;
+	fields[0] = (Uint32)now;
+	fields[1] = (Uint32)(now >> 32);
+	fields[2] = numrects;
+	SIXEL_CaptureRecord(this, 'F', fields, 3);
+	for ( i = 0; i < numrects; ++i ) {
+		rect = &rects[i];
+		fields[0] = rect->x;
+		fields[1] = rect->y;
+		fields[2] = rect->w;
+		fields[3] = rect->h;
+		fwrite(fields, sizeof(*fields), 4, SIXEL_capture);
+	}
+	for ( i = 0; i < numrects; ++i ) {
+		rect = &rects[i];
+		for ( y = rect->y; y < rect->y + rect->h; ++y ) {
+			fwrite(SIXEL_buffer + y * pitch + rect->x * SIXEL_bpp,
+			       SIXEL_bpp, rect->w, SIXEL_capture);
+		}
+	}
+	SIXEL_CaptureCheck(this);
+}
@@ -0,0 +1,37 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+
+
+#include "SDL_sixelvideo.h"
+
+/* Functions exported by SDL_sixelcapture.c to the rest of the sixel driver */
+
+/* Start recording to the file named by SDL_SIXEL_CAPTURE, if any */
+extern void SIXEL_OpenCapture(_THIS);
+extern void SIXEL_CloseCapture(_THIS);
+
+/* Record a mode change, a palette change or an update asked for by the
+   application, not the ones the driver makes on its own
+*/
+extern void SIXEL_CaptureMode(_THIS);
+extern void SIXEL_CapturePalette(_THIS, int firstcolor, int ncolors, SDL_Color *colors);
+extern void SIXEL_CaptureFrame(_THIS, int numrects, SDL_Rect *rects);
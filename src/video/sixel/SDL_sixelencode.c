@@ -0,0 +1,712 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+
+#include "SDL_config.h"
+
+/* In-tree sixel encoder for fixed palettes.
+
+   libsixel wants a tightly packed image, which means copying every
+   partial update out of the framebuffer first.  This encoder reads the
+   framebuffer in place using its pitch instead.  Since the palette never
+   changes, pixels are mapped to it without diffusion through a lookup
+   table indexed by their 5:5:5 color, which is close to what libsixel
+   does with BUILTIN_XTERM256 at a fraction of the cost.
+
+   Each band of six rows is first turned into palette indices, noting the
+   colors it uses.  Then for every color present, the sixel characters of
+   the band are computed 16 columns at a time with SSE2 when available,
+   and run-length encoded.
+
+   Bands are independent of each other, so with SDL_SIXEL_THREADS set a
+   tall image is cut into groups of bands encoded by a pool of worker
+   threads into their own buffers, which are then written out in order.
+   Each group defines the colors it uses itself.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL.h"
+#include "SDL_cpuinfo.h"
+#include "SDL_sixelvideo.h"
+#include "SDL_sixelencode_c.h"
+#include "SDL_sixelwriter_c.h"
+
+#if SDL_ASSEMBLY_ROUTINES && defined(__GNUC__) && defined(__SSE2__)
+#define SIXEL_SSE2 1
+#include <emmintrin.h>
+#endif
+
+/* Index in the lookup table of a 24-bit color */
+#define SIXEL_LUT_INDEX(r, g, b) \
+	((((r) >> 3) << 10) | (((g) >> 3) << 5) | ((b) >> 3))
+
+/* Intensities of the 6 levels of the xterm color cube */
+static const Uint8 cube_levels[6] = { 0, 95, 135, 175, 215, 255 };
+
+/* The 16 system colors at the start of the xterm palette */
+static const Uint8 system_colors[16 * 3] = {
+	  0,   0,   0,  205,   0,   0,    0, 205,   0,  205, 205,   0,
+	  0,   0, 238,  205,   0, 205,    0, 205, 205,  229, 229, 229,
+	127, 127, 127,  255,   0,   0,    0, 255,   0,  255, 255,   0,
+	 92,  92, 255,  255,   0, 255,    0, 255, 255,  255, 255, 255,
+};
+
+static void SIXEL_BuildPalette(_THIS)
+{
+	int i, r, g, b;
+	Uint8 *entry;
+
+	memcpy(SIXEL_palette, system_colors, sizeof(system_colors));
+	entry = SIXEL_palette + 16 * 3;
+	for ( r = 0; r < 6; ++r ) {
+		for ( g = 0; g < 6; ++g ) {
+			for ( b = 0; b < 6; ++b ) {
+				*entry++ = cube_levels[r];
+				*entry++ = cube_levels[g];
+				*entry++ = cube_levels[b];
+			}
+		}
+	}
+	for ( i = 0; i < 24; ++i ) {
+		*entry++ = 8 + i * 10;
+		*entry++ = 8 + i * 10;
+		*entry++ = 8 + i * 10;
+	}
+}
+
+/* Map every 5:5:5 color to the nearest palette entry */
+static void SIXEL_BuildLookup(_THIS, int ncolors)
+{
+	int r, g, b, i;
+	int dr, dg, db, dist, best, best_dist;
+	Uint8 *entry, *lut;
+
+	lut = SIXEL_lut;
+	for ( r = 4; r < 256; r += 8 ) {
+		for ( g = 4; g < 256; g += 8 ) {
+			for ( b = 4; b < 256; b += 8 ) {
+				best = 0;
+				best_dist = 0x7fffffff;
+				entry = SIXEL_palette;
+				for ( i = 0; i < ncolors; ++i, entry += 3 ) {
+					dr = r - entry[0];
+					dg = g - entry[1];
+					db = b - entry[2];
+					dist = dr * dr + dg * dg + db * db;
+					if ( dist < best_dist ) {
+						best = i;
+						best_dist = dist;
+					}
+				}
+				*lut++ = best;
+			}
+		}
+	}
+}
+
+void SIXEL_SetPalette(_THIS, int firstcolor, int ncolors, SDL_Color *colors)
+{
+	Uint8 *entry = SIXEL_palette + firstcolor * 3;
+	int i;
+
+	for ( i = 0; i < ncolors; ++i ) {
+		*entry++ = colors[i].r;
+		*entry++ = colors[i].g;
+		*entry++ = colors[i].b;
+	}
+}
+
+/* Count the colors of every 4th pixel of every 4th row in 4:4:4 bins,
+   and gather them into a small 24-bit picture to build palettes from.
+*/
+static Uint32 SIXEL_Histogram(_THIS, const Uint8 *pixels, Uint32 *hist)
+{
+	int x, y;
+	int pitch = SIXEL_w * SIXEL_bpp;
+	const Uint8 *src;
+	Uint8 *dst = SIXEL_samples;
+	Uint32 pixel, total = 0;
+
+	memset(hist, 0, SIXEL_HIST_SIZE * sizeof(*hist));
+	for ( y = 0; y < SIXEL_h; y += 4 ) {
+		src = pixels + y * pitch;
+		for ( x = 0; x < SIXEL_w; x += 4, src += 4 * SIXEL_bpp, dst += 3 ) {
+			if ( SIXEL_bpp == 4 ) {
+				pixel = *(const Uint32 *)src;
+				dst[0] = (Uint8)(pixel >> 16);
+				dst[1] = (Uint8)(pixel >> 8);
+				dst[2] = (Uint8)pixel;
+			} else {
+				dst[0] = src[0];
+				dst[1] = src[1];
+				dst[2] = src[2];
+			}
+			++hist[((dst[0] >> 4) << 8) | ((dst[1] >> 4) << 4) | (dst[2] >> 4)];
+			++total;
+		}
+	}
+	return(total);
+}
+
+void SIXEL_AdaptPalette(_THIS, unsigned char *pixels)
+{
+	sixel_dither_t *dither;
+	Uint32 *reference = SIXEL_histogram;
+	Uint32 *hist = SIXEL_histogram + SIXEL_HIST_SIZE;
+	Uint32 total, moved;
+	int i, ncolors;
+	int sample_w = (SIXEL_w + 3) / 4;
+	int sample_h = (SIXEL_h + 3) / 4;
+
+	/* The first frame always gets its own palette, and the next few are
+	   all looked at while the application sets up its screen */
+	if ( SIXEL_palette_age >= 0 ) {
+		if ( SIXEL_palette_warmup > 0 ) {
+			--SIXEL_palette_warmup;
+		} else if ( ++SIXEL_palette_age < SIXEL_PALETTE_INTERVAL ) {
+			return;
+		}
+	}
+	if ( ! SIXEL_samples ) {
+		SIXEL_samples = malloc(sample_w * sample_h * 3);
+		if ( ! SIXEL_samples ) {
+			return;
+		}
+	}
+	total = SIXEL_Histogram(this, pixels, hist);
+	if ( SIXEL_palette_age >= 0 ) {
+		SIXEL_palette_age = 0;
+		moved = 0;
+		for ( i = 0; i < SIXEL_HIST_SIZE; ++i ) {
+			moved += (hist[i] > reference[i]) ?
+			         hist[i] - reference[i] : reference[i] - hist[i];
+		}
+		/* Every sample that moved counts twice */
+		if ( (Uint64)moved * 100 <= (Uint64)SIXEL_palette_drift * 2 * total ) {
+			return;
+		}
+	}
+
+	/* Median cut over the samples, libsixel shares it for its images */
+	dither = sixel_dither_create(SDL_max(SDL_min(SIXEL_term_colors, 256), 2));
+	if ( ! dither ) {
+		return;
+	}
+	if ( sixel_dither_initialize(dither, SIXEL_samples, sample_w, sample_h, 3,
+	                             LARGE_NORM, REP_CENTER_BOX, QUALITY_AUTO) != 0 ) {
+		sixel_dither_unref(dither);
+		return;
+	}
+	sixel_dither_set_diffusion_type(dither, DIFFUSE_NONE);
+	SDL_mutexP(SIXEL_mutex);
+	sixel_dither_unref(SIXEL_dither);
+	SIXEL_dither = dither;
+
+	ncolors = sixel_dither_get_num_of_palette_colors(dither);
+	memcpy(SIXEL_palette, sixel_dither_get_palette(dither), ncolors * 3);
+	SIXEL_BuildLookup(this, ncolors);
+	SIXEL_lut_default = 0;
+	SDL_mutexV(SIXEL_mutex);
+	memcpy(reference, hist, SIXEL_HIST_SIZE * sizeof(*hist));
+	SIXEL_palette_age = 0;
+	++SIXEL_stats.palette_builds;
+}
+
+/* Make room for at least len more bytes of output */
+static int SIXEL_Reserve(sixel_context_t *ctx, int len)
+{
+	char *out;
+	int size;
+
+	if ( ctx->outlen + len <= ctx->outsize ) {
+		return(0);
+	}
+	if ( ctx->error ) {
+		return(-1);
+	}
+	size = ctx->outsize * 2;
+	while ( ctx->outlen + len > size ) {
+		size *= 2;
+	}
+	out = realloc(ctx->out, size);
+	if ( ! out ) {
+		ctx->error = 1;
+		return(-1);
+	}
+	ctx->out = out;
+	ctx->outsize = size;
+	return(0);
+}
+
+static void SIXEL_PutNumber(sixel_context_t *ctx, int n)
+{
+	char digits[12];
+	int i = 0;
+
+	do {
+		digits[i++] = '0' + n % 10;
+		n /= 10;
+	} while ( n > 0 );
+	while ( i > 0 ) {
+		ctx->out[ctx->outlen++] = digits[--i];
+	}
+}
+
+/* Emit count repetitions of a sixel character */
+static void SIXEL_PutRun(sixel_context_t *ctx, int count, int bits)
+{
+	if ( SIXEL_Reserve(ctx, 16) < 0 ) {
+		return;
+	}
+	if ( count > 3 ) {
+		ctx->out[ctx->outlen++] = '!';
+		SIXEL_PutNumber(ctx, count);
+		ctx->out[ctx->outlen++] = '?' + bits;
+	} else {
+		while ( count-- > 0 ) {
+			ctx->out[ctx->outlen++] = '?' + bits;
+		}
+	}
+}
+
+static void SIXEL_PutColor(_THIS, sixel_context_t *ctx, int color, int define)
+{
+	Uint8 *rgb;
+
+	if ( SIXEL_Reserve(ctx, 32) < 0 ) {
+		return;
+	}
+	ctx->out[ctx->outlen++] = '#';
+	SIXEL_PutNumber(ctx, color);
+	if ( define ) {
+		/* Color registers take percentages */
+		rgb = SIXEL_palette + color * 3;
+		ctx->out[ctx->outlen++] = ';';
+		ctx->out[ctx->outlen++] = '2';
+		ctx->out[ctx->outlen++] = ';';
+		SIXEL_PutNumber(ctx, (rgb[0] * 100 + 127) / 255);
+		ctx->out[ctx->outlen++] = ';';
+		SIXEL_PutNumber(ctx, (rgb[1] * 100 + 127) / 255);
+		ctx->out[ctx->outlen++] = ';';
+		SIXEL_PutNumber(ctx, (rgb[2] * 100 + 127) / 255);
+	}
+}
+
+static void SIXEL_PutChar(sixel_context_t *ctx, char c)
+{
+	if ( SIXEL_Reserve(ctx, 1) == 0 ) {
+		ctx->out[ctx->outlen++] = c;
+	}
+}
+
+/* Compute the sixel characters of one color over a band */
+static void SIXEL_BandSixels(sixel_context_t *ctx, int color, int w, int rows)
+{
+	int x, row;
+	Uint8 bits;
+	const Uint8 *band;
+	Uint8 *sixels = ctx->sixels;
+#if SIXEL_SSE2
+	__m128i key, bit, acc, weight;
+
+	if ( rows == 6 && SDL_HasSSE2() ) {
+		key = _mm_set1_epi8((char)color);
+		for ( x = 0; x + 16 <= w; x += 16 ) {
+			acc = _mm_setzero_si128();
+			band = ctx->band + x;
+			for ( row = 0; row < 6; ++row, band += w ) {
+				weight = _mm_set1_epi8((char)(1 << row));
+				bit = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)band), key);
+				acc = _mm_or_si128(acc, _mm_and_si128(bit, weight));
+			}
+			_mm_storeu_si128((__m128i *)(sixels + x), acc);
+		}
+	} else {
+		x = 0;
+	}
+#else
+	x = 0;
+#endif
+	for ( ; x < w; ++x ) {
+		bits = 0;
+		band = ctx->band + x;
+		for ( row = 0; row < rows; ++row, band += w ) {
+			if ( *band == color ) {
+				bits |= 1 << row;
+			}
+		}
+		sixels[x] = bits;
+	}
+}
+
+/* Encode the bands of rows y1 to y2 of an image h rows high */
+static void SIXEL_EncodeBands(_THIS, sixel_context_t *ctx, const Uint8 *pixels,
+                              int pitch, int w, int h, int y1, int y2)
+{
+	Uint8 defined[256];
+	Uint8 used[256];
+	Uint8 colors[256];
+	int ncolors;
+	int x, y, row, rows, i, color;
+	int bits, last, count;
+	const Uint8 *src;
+	Uint8 *band;
+	const Uint8 *lut = SIXEL_lut;
+	Uint64 start;
+
+	/* Colors are defined the first time they are used */
+	memset(defined, 0, sizeof(defined));
+
+	for ( y = y1; y < y2; y += 6 ) {
+		rows = SDL_min(6, h - y);
+
+		/* Map the band to palette indices */
+		start = SIXEL_GetMicroseconds();
+		memset(used, 0, sizeof(used));
+		ncolors = 0;
+		for ( row = 0; row < rows; ++row ) {
+			src = pixels + (y + row) * pitch;
+			band = ctx->band + row * w;
+			if ( SIXEL_bpp == 1 ) {
+				/* Indexed pixels are palette indices already */
+				for ( x = 0; x < w; ++x ) {
+					color = src[x];
+					band[x] = color;
+					if ( ! used[color] ) {
+						used[color] = 1;
+						colors[ncolors++] = color;
+					}
+				}
+				continue;
+			}
+			if ( SIXEL_bpp == 4 ) {
+				/* XRGB pixels, read whole */
+				const Uint32 *src32 = (const Uint32 *)src;
+				Uint32 pixel;
+
+				for ( x = 0; x < w; ++x ) {
+					pixel = src32[x];
+					color = lut[((pixel >> 9) & 0x7c00) |
+					            ((pixel >> 6) & 0x03e0) |
+					            ((pixel >> 3) & 0x001f)];
+					band[x] = color;
+					if ( ! used[color] ) {
+						used[color] = 1;
+						colors[ncolors++] = color;
+					}
+				}
+				continue;
+			}
+			for ( x = 0; x < w; ++x, src += 3 ) {
+				color = lut[SIXEL_LUT_INDEX(src[0], src[1], src[2])];
+				band[x] = color;
+				if ( ! used[color] ) {
+					used[color] = 1;
+					colors[ncolors++] = color;
+				}
+			}
+		}
+		ctx->quantize_time += SIXEL_GetMicroseconds() - start;
+
+		/* One pass over the band for each color present in it */
+		if ( y > 0 ) {
+			SIXEL_PutChar(ctx, '-');
+		}
+		for ( i = 0; i < ncolors; ++i ) {
+			color = colors[i];
+			if ( i > 0 ) {
+				SIXEL_PutChar(ctx, '$');
+			}
+			SIXEL_PutColor(this, ctx, color, ! defined[color]);
+			defined[color] = 1;
+			SIXEL_BandSixels(ctx, color, w, rows);
+			last = ctx->sixels[0];
+			count = 1;
+			for ( x = 1; x < w; ++x ) {
+				bits = ctx->sixels[x];
+				if ( bits == last ) {
+					++count;
+				} else {
+					SIXEL_PutRun(ctx, count, last);
+					last = bits;
+					count = 1;
+				}
+			}
+			/* Trailing blank sixels need not be sent */
+			if ( last != 0 ) {
+				SIXEL_PutRun(ctx, count, last);
+			}
+		}
+	}
+}
+
+static int SIXEL_WorkerThread(sixel_worker_t *worker)
+{
+	SDL_VideoDevice *this = worker->device;
+
+	for ( ; ; ) {
+		if ( SDL_SemWait(worker->start) < 0 ) {
+			/* Hand the bands back, the calling thread encodes them */
+			worker->failed = 1;
+			SDL_SemPost(SIXEL_workers_done);
+			break;
+		}
+		if ( SIXEL_workers_quit ) {
+			break;
+		}
+		SIXEL_EncodeBands(this, &worker->ctx, worker->pixels, worker->pitch,
+		                  worker->w, worker->h, worker->y1, worker->y2);
+		if ( SDL_SemPost(SIXEL_workers_done) < 0 ) {
+			worker->failed = 1;
+			break;
+		}
+	}
+	return(0);
+}
+
+static int SIXEL_InitContext(sixel_context_t *ctx, int width)
+{
+	ctx->band = malloc(width * 6);
+	ctx->sixels = malloc(width + 16);
+	ctx->out = malloc(SIXEL_OUTBUF_SIZE);
+	ctx->outsize = SIXEL_OUTBUF_SIZE;
+	ctx->outlen = 0;
+	ctx->error = 0;
+	if ( ! ctx->band || ! ctx->sixels || ! ctx->out ) {
+		return(-1);
+	}
+	return(0);
+}
+
+static void SIXEL_FreeContext(sixel_context_t *ctx)
+{
+	if ( ctx->band ) {
+		free(ctx->band);
+		ctx->band = NULL;
+	}
+	if ( ctx->sixels ) {
+		free(ctx->sixels);
+		ctx->sixels = NULL;
+	}
+	if ( ctx->out ) {
+		free(ctx->out);
+		ctx->out = NULL;
+	}
+}
+
+static void SIXEL_FreeWorkers(_THIS);
+
+int SIXEL_InitEncoder(_THIS, int width)
+{
+	int i;
+	sixel_worker_t *worker;
+
+	SIXEL_FreeWorkers(this);
+
+	if ( ! SIXEL_lut ) {
+		SIXEL_lut = malloc(SIXEL_LUT_SIZE);
+		SIXEL_lut_default = 0;
+	}
+	SIXEL_workers = calloc(SIXEL_nthreads, sizeof(*SIXEL_workers));
+	if ( SIXEL_adaptive ) {
+		SIXEL_histogram = malloc(2 * SIXEL_HIST_SIZE * sizeof(*SIXEL_histogram));
+	}
+	if ( ! SIXEL_lut || ! SIXEL_workers ||
+	     (SIXEL_adaptive && ! SIXEL_histogram) ) {
+		SIXEL_QuitEncoder(this);
+		SDL_OutOfMemory();
+		return(-1);
+	}
+	/* Every mode starts with the default palette, which only needs to be
+	   mapped again after an adaptive one took its place.  Indexed modes
+	   don't look colors up at all. */
+	SIXEL_BuildPalette(this);
+	if ( SIXEL_bpp != 1 && ! SIXEL_lut_default ) {
+		SIXEL_BuildLookup(this, 256);
+		SIXEL_lut_default = 1;
+	}
+	SIXEL_palette_age = -1;
+	SIXEL_palette_warmup = SIXEL_PALETTE_INTERVAL;
+
+	/* The first context belongs to the calling thread, which also takes
+	   over the bands of any thread that couldn't be started */
+	SIXEL_workers_quit = 0;
+	SIXEL_nworkers = SIXEL_nthreads;
+	if ( SIXEL_nthreads > 1 ) {
+		SIXEL_workers_done = SDL_CreateSemaphore(0);
+	}
+	for ( i = 0; i < SIXEL_nthreads; ++i ) {
+		worker = &SIXEL_workers[i];
+		worker->device = this;
+		if ( SIXEL_InitContext(&worker->ctx, width) < 0 ) {
+			SIXEL_QuitEncoder(this);
+			SDL_OutOfMemory();
+			return(-1);
+		}
+		if ( i > 0 ) {
+			if ( SIXEL_workers_done ) {
+				worker->start = SDL_CreateSemaphore(0);
+			}
+			if ( worker->start ) {
+				worker->thread = SDL_CreateThread(
+					(int (*)(void *))SIXEL_WorkerThread, worker);
+			}
+			worker->failed = ! worker->thread;
+		}
+	}
+	return(0);
+}
+
+/* Everything but the lookup table, which outlives mode changes */
+static void SIXEL_FreeWorkers(_THIS)
+{
+	int i;
+	sixel_worker_t *worker;
+
+	if ( SIXEL_workers ) {
+		SIXEL_workers_quit = 1;
+		for ( i = 0; i < SIXEL_nthreads; ++i ) {
+			worker = &SIXEL_workers[i];
+			if ( worker->thread ) {
+				SDL_SemPost(worker->start);
+				SDL_WaitThread(worker->thread, NULL);
+			}
+			if ( worker->start ) {
+				SDL_DestroySemaphore(worker->start);
+			}
+			SIXEL_FreeContext(&worker->ctx);
+		}
+		free(SIXEL_workers);
+		SIXEL_workers = NULL;
+	}
+	if ( SIXEL_workers_done ) {
+		SDL_DestroySemaphore(SIXEL_workers_done);
+		SIXEL_workers_done = NULL;
+	}
+	if ( SIXEL_histogram ) {
+		free(SIXEL_histogram);
+		SIXEL_histogram = NULL;
+	}
+	if ( SIXEL_samples ) {
+		free(SIXEL_samples);
+		SIXEL_samples = NULL;
+	}
+}
+
+void SIXEL_QuitEncoder(_THIS)
+{
+	SIXEL_FreeWorkers(this);
+	if ( SIXEL_lut ) {
+		free(SIXEL_lut);
+		SIXEL_lut = NULL;
+	}
+	SIXEL_lut_default = 0;
+}
+
+void SIXEL_EncodeStrided(_THIS, const Uint8 *pixels, int pitch, int w, int h)
+{
+	sixel_context_t *ctx;
+	sixel_worker_t *worker;
+	int i, n, nbands, per, posted, header;
+	int error;
+
+	/* Only split images that give every thread a fair amount of work */
+	nbands = (h + 5) / 6;
+	posted = 0;
+	n = SDL_min(SIXEL_nworkers, nbands / SIXEL_MIN_BANDS);
+	if ( n < 1 ) {
+		n = 1;
+	}
+	per = (nbands + n - 1) / n;
+	for ( i = 0; i < n; ++i ) {
+		worker = &SIXEL_workers[i];
+		worker->ctx.outlen = 0;
+		worker->ctx.error = 0;
+		worker->ctx.quantize_time = 0;
+		worker->pixels = pixels;
+		worker->pitch = pitch;
+		worker->w = w;
+		worker->h = h;
+		worker->y1 = i * per * 6;
+		worker->y2 = SDL_min((i + 1) * per * 6, h);
+		if ( i > 0 && ! worker->failed ) {
+			if ( SDL_SemPost(worker->start) < 0 ) {
+				worker->failed = 1;
+			} else {
+				++posted;
+			}
+		}
+	}
+
+	ctx = &SIXEL_workers[0].ctx;
+	if ( SIXEL_Reserve(ctx, 32) == 0 ) {
+		ctx->out[ctx->outlen++] = '\033';
+		ctx->out[ctx->outlen++] = 'P';
+		ctx->out[ctx->outlen++] = 'q';
+		ctx->out[ctx->outlen++] = '"';
+		ctx->out[ctx->outlen++] = '1';
+		ctx->out[ctx->outlen++] = ';';
+		ctx->out[ctx->outlen++] = '1';
+		ctx->out[ctx->outlen++] = ';';
+		SIXEL_PutNumber(ctx, w);
+		ctx->out[ctx->outlen++] = ';';
+		SIXEL_PutNumber(ctx, h);
+	}
+	header = ctx->outlen;
+	SIXEL_EncodeBands(this, ctx, pixels, pitch, w, h, 0, SIXEL_workers[0].y2);
+
+	for ( i = 0; i < posted; ++i ) {
+		if ( SDL_SemWait(SIXEL_workers_done) < 0 ) {
+			/* The threads may still be busy, leave them alone for
+			   good and encode the whole image here */
+			SIXEL_nworkers = 1;
+			ctx->outlen = header;
+			SIXEL_EncodeBands(this, ctx, pixels, pitch, w, h, 0, h);
+			n = 1;
+			break;
+		}
+	}
+	for ( i = 1; i < n; ++i ) {
+		worker = &SIXEL_workers[i];
+		if ( worker->failed ) {
+			SIXEL_EncodeBands(this, &worker->ctx, pixels, pitch,
+			                  w, h, worker->y1, worker->y2);
+		}
+	}
+
+	error = 0;
+	for ( i = 0; i < n; ++i ) {
+		error |= SIXEL_workers[i].ctx.error;
+		SIXEL_stats.quantize_us += SIXEL_workers[i].ctx.quantize_time;
+	}
+	if ( error ) {
+		SDL_OutOfMemory();
+		return;
+	}
+	for ( i = 0; i < n; ++i ) {
+		ctx = &SIXEL_workers[i].ctx;
+		SIXEL_WriteBytes(this, ctx->out, ctx->outlen);
+	}
+	SIXEL_WriteBytes(this, "\033\\", 2);
+}
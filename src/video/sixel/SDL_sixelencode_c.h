@@ -0,0 +1,46 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+
+
+#include "SDL_sixelvideo.h"
+
+/* Functions exported by SDL_sixelencode.c to the rest of the sixel driver */
+
+/* Set up the palette and scratch space for images up to width pixels */
+extern int SIXEL_InitEncoder(_THIS, int width);
+extern void SIXEL_QuitEncoder(_THIS);
+
+/* With an adaptive palette, rebuild it from a full frame of direct color
+   when its colors have drifted away from those it was built for.  Only
+   the switch to the new palette takes the output lock, so the application
+   thread can do this from the framebuffer while the encoder thread works.
+*/
+extern void SIXEL_AdaptPalette(_THIS, unsigned char *pixels);
+
+/* Set palette entries of the 8-bit indexed mode */
+extern void SIXEL_SetPalette(_THIS, int firstcolor, int ncolors, SDL_Color *colors);
+
+/* Encode a w x h region of 24-bit, 32-bit XRGB or 8-bit indexed pixels,
+   as set by SIXEL_bpp, whose rows are pitch bytes apart, straight out of
+   the framebuffer, and queue it for the terminal.
+*/
+extern void SIXEL_EncodeStrided(_THIS, const Uint8 *pixels, int pitch, int w, int h);
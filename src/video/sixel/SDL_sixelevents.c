@@ -26,14 +26,19 @@
 #include <sixel.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <signal.h>
 #include <unistd.h>
-#include <sys/select.h>
 
 #include "SDL.h"
 #include "../../events/SDL_sysevents.h"
 #include "../../events/SDL_events_c.h"
 #include "SDL_sixelvideo.h"
 #include "SDL_sixelevents_c.h"
+#include "SDL_sixelwriter_c.h"
+#include "SDL_sixelscale_c.h"
+#include "SDL_sixelinput_c.h"
+#include "SDL_sixelprobe_c.h"
 
 #if 0
 #define SIXEL_DEBUG 1
@@ -53,23 +58,8 @@
 #define SIXEL_MOUSE_SGR         (1 << 12 | ('<' - ';') << 4 << 6 | ('M' - '@'))
 #define SIXEL_MOUSE_SGR_RELEASE (1 << 12 | ('<' - ';') << 4 << 6 | ('m' - '@'))
 #define SIXEL_MOUSE_DEC         (1 << 12 | ('&' - 0x1f) << 6 | ('w' - '@'))
-#define SIXEL_DTTERM_SEQS       (1 << 12 | ('t' - '@'))
 #define SIXEL_UNKNOWN           (513)
 
-typedef struct _key {
-	int params[256];
-	int nparams;
-	int value;
-} sixel_key_t;
-
-enum _state {
-	STATE_GROUND = 0,
-	STATE_ESC = 1,
-	STATE_CSI = 2,
-	STATE_CSI_IGNORE = 3,
-	STATE_CSI_PARAM = 4,
-};
-
 /* The translation tables from a console scancode to a SDL keysym */
 static SDLKey keymap[1 << 13];
 
@@ -79,399 +69,388 @@ static int GetKsymScancode(SDLKey sym);
 static int GetState(int code);
 static SDL_keysym *TranslateKey(int scancode, SDL_keysym *keysym);
 
-static int get_input(char *buf, int size) {
-	fd_set fdset;
-	struct timeval timeout;
-	FD_ZERO(&fdset);
-	FD_SET(STDIN_FILENO, &fdset);
-	timeout.tv_sec = 0;
-	timeout.tv_usec = 1;
-	if ( select(STDIN_FILENO + 1, &fdset, NULL, NULL, &timeout) == 1 )
-		return read(STDIN_FILENO, buf, size);
-	return 0;
+/* The window changed size, the terminal is asked for the new one when
+   events are next pumped, and SDL_VIDEORESIZE is posted with its answer
+*/
+static volatile sig_atomic_t winch_caught = 0;
+static int winch_watched = 0;
+static struct sigaction winch_action;
+
+static void SIXEL_CatchWinch(int sig)
+{
+	winch_caught = 1;
 }
 
-static int getkeys(char *buf, int nread, sixel_key_t *keys)
+void SIXEL_WatchResize(_THIS)
 {
-	int i, c;
-	int size = 0;
-	static int state = STATE_GROUND;
-	static int ibytes = 0;
-	static int pbytes = 0;
-
-	for ( i=0; i<nread; i++ ) {
-		c = buf[i];
-		switch (state) {
-		case STATE_GROUND:
-			switch (c) {
-			case 0x1b:
-				state = STATE_ESC;
-				break;
-			default:
-				keys[size++].value = c;
-				break;
-			}
-			break;
-		case STATE_ESC:
-			switch (c) {
-			case 'O':
-			case '[':
-				keys[size].nparams = 0;
-				pbytes = 0;
-				state = STATE_CSI;
-				break;
-			default:
-				keys[size++].value = 0x1b;
-				keys[size++].value = c;
-				state = STATE_GROUND;
-				break;
-			}
-			break;
-		case STATE_CSI:
-			switch (c) {
-			case '\x1b':
-				state = STATE_ESC;
-				break;
-			case '\x00'...'\x1a':
-			case '\x1c'...'\x1f':
-			case '\x7f':
-				break;
-			case ' '...'/':
-				ibytes = c - ' ';
-				pbytes = 0;
-				state = STATE_CSI_PARAM;
-				break;
-			case '0'...'9':
-				ibytes = 0;
-				pbytes = c - '0';
-				keys[size].nparams = 0;
-				state = STATE_CSI_PARAM;
-				break;
-			case '<'...'?':
-				ibytes = (c - ';') << 4;
-				keys[size].nparams = 0;
-				state = STATE_CSI_PARAM;
-				break;
-			case '@'...'~':
-				keys[size].nparams = 0;
-				keys[size++].value = 1 << 12 | (c - '@');
-				state = STATE_GROUND;
-				break;
-			default:
-				state = STATE_GROUND;
-				break;
-			}
-			break;
-		case STATE_CSI_PARAM:
-			switch (c) {
-			case '\x1b':
-				state = STATE_ESC;
-				break;
-			case '\x00'...'\x1a':
-			case '\x1c'...'\x1f':
-			case '\x7f':
-				break;
-			case ' '...'/':
-				ibytes |= c - 0x1f;
-				state = STATE_CSI_PARAM;
-				break;
-			case '0'...'9':
-				pbytes = pbytes * 10 + c - '0';
-				state = STATE_CSI_PARAM;
-				break;
-			case ':'...';':
-				if ( keys[size].nparams < sizeof(keys[size].params) / sizeof(*keys[size].params) ) {
-					keys[size].params[keys[size].nparams++] = pbytes;
-					pbytes = 0;
-				}
-				break;
-			case '@'...'~':
-				if ( keys[size].nparams < sizeof(keys[size].params) / sizeof(*keys[size].params) ) {
-					keys[size].params[keys[size].nparams++] = pbytes;
-					keys[size++].value = 1 << 12 | ibytes << 6  | c - '@';
-				}
-				state = STATE_GROUND;
-				break;
-			default:
-				state = STATE_GROUND;
-				break;
-			}
-			break;
+	struct sigaction action;
+
+	if ( SIXEL_headless || winch_watched ) {
+		return;
+	}
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = SIXEL_CatchWinch;
+	sigemptyset(&action.sa_mask);
+	action.sa_flags = SA_RESTART;
+	if ( sigaction(SIGWINCH, &action, &winch_action) == 0 ) {
+		winch_watched = 1;
+	}
+	winch_caught = 0;
+}
+
+void SIXEL_UnwatchResize(_THIS)
+{
+	if ( winch_watched ) {
+		sigaction(SIGWINCH, &winch_action, NULL);
+		winch_watched = 0;
+	}
+}
+
+static int SIXEL_PostResize(_THIS)
+{
+	int w = SIXEL_term_pixel_w;
+	int h = SIXEL_term_pixel_h;
+	int posted;
+
+	if ( ! SIXEL_resizable ) {
+		/* The picture is scaled to the new size instead */
+		return(0);
+	}
+	SIXEL_FitArea(this, &w, &h);
+	SDL_Lock_EventThread();
+	posted = SDL_PrivateResize(w, h);
+	SDL_Unlock_EventThread();
+	return(posted);
+}
+
+/* Mouse reports only move the pointer, the motion event is posted once
+   per pump so a flood of any-event reports doesn't fill the event queue.
+   SDL works out xrel/yrel against the last posted position, so the one
+   event carries the sum of the moves it stands for.
+*/
+static int SIXEL_FlushMotion(_THIS)
+{
+	int posted = 0;
+
+	if ( SIXEL_mouse_posted_x != SIXEL_mouse_x ||
+	     SIXEL_mouse_posted_y != SIXEL_mouse_y ) {
+		SDL_Lock_EventThread();
+		SDL_PrivateAppActive(1, SDL_APPMOUSEFOCUS);
+		posted = SDL_PrivateMouseMotion(0, 0, SIXEL_mouse_x, SIXEL_mouse_y);
+		SIXEL_mouse_posted_x = SIXEL_mouse_x;
+		SIXEL_mouse_posted_y = SIXEL_mouse_y;
+		SDL_Unlock_EventThread();
+	}
+	return(posted);
+}
+
+/* Point the mouse where a SGR report says, which is a character cell
+   unless the terminal agreed to report pixels (mode 1016).  Returns 0 if
+   the report can't be placed yet.
+*/
+static int SIXEL_MousePosition(_THIS, sixel_key_t *key)
+{
+	if ( key->nparams < 3 ) {
+		return(0);
+	}
+	if ( SIXEL_mouse_pixels ) {
+		SIXEL_mouse_x = key->params[1] > 0 ? key->params[1] - 1 : 0;
+		SIXEL_mouse_y = key->params[2] > 0 ? key->params[2] - 1 : 0;
+	} else {
+		if ( SIXEL_cell_h == 0 || SIXEL_cell_w == 0 ) {
+			return(0);
 		}
+		SIXEL_mouse_x = (key->params[1] - 1) * SIXEL_pixel_w / SIXEL_cell_w;
+		SIXEL_mouse_y = (key->params[2] - 1) * SIXEL_pixel_h / SIXEL_cell_h;
 	}
-	return size;
+	SIXEL_ScalePoint(this, &SIXEL_mouse_x, &SIXEL_mouse_y);
+	return(1);
 }
 
+/* Buttons go out in order, each at the position it was reported at */
+static int SIXEL_PostButton(_THIS, Uint8 state, Uint8 button)
+{
+	int posted;
+
+	posted = SIXEL_FlushMotion(this);
+	posted += SDL_PrivateMouseButton(state, button, 0, 0);
+	return(posted);
+}
 
 void SIXEL_PumpEvents(_THIS)
 {
 	int posted = 0;
-	static int prev_x = -1, prev_y = -1;
 #if SIXEL_DEBUG
 	static int events = 0;
 #endif
-	char buf[4096];
-	static sixel_key_t keys[4096];
 	SDL_keysym keysym;
 	sixel_key_t *key;
-	int nread, nkeys;
-	int i;
 
 	if(!this->screen) /* Wait till we got the screen initialized */
 		return;
 
-	SDL_mutexP(SIXEL_mutex);
-	nread = get_input(buf, sizeof(buf));
-	SDL_mutexV(SIXEL_mutex);
-	if ( nread > 0 ) {
-		nkeys = getkeys(buf, nread, keys);
-		if ( nkeys >= sizeof(keys) / sizeof(*keys) )
-			nkeys = sizeof(keys) / sizeof(*keys) - 1;
-		for ( i = 0; i < nkeys; ++i ) {
-			key = keys + i;
-			switch (key->value) {
-			case SIXEL_DTTERM_SEQS:
-				switch (key->params[0]) {
-				case 4:
-					SIXEL_pixel_h = key->params[1];
-					SIXEL_pixel_w = key->params[2];
-					break;
-				case 8:
-					SIXEL_cell_h = key->params[1];
-					SIXEL_cell_w = key->params[2];
-					break;
-				default:
-					break;
+	SIXEL_PumpOutput(this);
+
+	/* Nobody is typing at a file */
+	if ( SIXEL_headless )
+		return;
+
+	if ( winch_caught ) {
+		winch_caught = 0;
+		SIXEL_resize_pending = 1;
+		SDL_mutexP(SIXEL_mutex);
+		SIXEL_WriteBytes(this, "\033[14t\033[18t", 10);
+		SIXEL_FlushWriter(this);
+		SDL_mutexV(SIXEL_mutex);
+	}
+
+	while ( (key = SIXEL_PeekKey(this)) != NULL ) {
+		switch (key->value) {
+		case SIXEL_DTTERM_SEQS:
+			switch (key->params[0]) {
+			case 4:
+				SIXEL_pixel_h = key->params[1];
+				SIXEL_pixel_w = key->params[2];
+				SIXEL_term_pixel_h = SIXEL_pixel_h;
+				SIXEL_term_pixel_w = SIXEL_pixel_w;
+				if ( SIXEL_resize_pending ) {
+					SIXEL_resize_pending = 0;
+					SIXEL_BuildModes(this);
+					posted += SIXEL_PostResize(this);
+					/* Whatever was on screen was cut or moved */
+					SIXEL_RepaintScreen(this);
 				}
 				break;
-			case SIXEL_MOUSE_SGR:
-				if ( key->nparams < 3 )
-					break;
-				if ( SIXEL_cell_h == 0 || SIXEL_cell_w == 0 )
-					break;
-				SIXEL_mouse_y = (key->params[2] - 1) * (SIXEL_pixel_h / SIXEL_cell_h);
-				SIXEL_mouse_x = (key->params[1] - 1) * (SIXEL_pixel_w / SIXEL_cell_w);
-				switch (key->params[0]) {
-				case 0:
-					if (!(SIXEL_mouse_button & 1)) {
-						posted += SDL_PrivateMouseButton(SDL_PRESSED, 1, 0, 0);
-						SIXEL_mouse_button |= 1;
-					}
-					break;
-				case 1:
-					if (!(SIXEL_mouse_button & 2)) {
-						posted += SDL_PrivateMouseButton(SDL_PRESSED, 2, 0, 0);
-						SIXEL_mouse_button |= 2;
-					}
-					break;
-				case 2:
-					if (!(SIXEL_mouse_button & 4)) {
-						posted += SDL_PrivateMouseButton(SDL_PRESSED, 3, 0, 0);
-						SIXEL_mouse_button |= 4;
-					}
-					break;
-				case 33: /* button1 dragging */
-				case 34: /* button2 dragging */
-				case 35: /* button3 dragging */
-				default:
-					break;
+			case 8:
+				SIXEL_cell_h = key->params[1];
+				SIXEL_cell_w = key->params[2];
+				break;
+			default:
+				break;
+			}
+			break;
+		case SIXEL_REPLY_DA1:
+		case SIXEL_REPLY_DECRPM:
+		case SIXEL_REPLY_XTSMGRAPHICS:
+			/* Answers to the startup probe that came in late */
+			SIXEL_ProbeReply(this, key);
+			break;
+		case SIXEL_MOUSE_SGR:
+			if ( ! SIXEL_MousePosition(this, key) )
+				break;
+			switch (key->params[0]) {
+			case 0:
+				if (!(SIXEL_mouse_button & 1)) {
+					posted += SIXEL_PostButton(this, SDL_PRESSED, 1);
+					SIXEL_mouse_button |= 1;
 				}
 				break;
-			case SIXEL_MOUSE_SGR_RELEASE:
-				if ( key->nparams < 3 )
-					break;
-				if ( SIXEL_cell_h == 0 || SIXEL_cell_w == 0 )
-					break;
-				SIXEL_mouse_y = (key->params[2] - 1) * SIXEL_pixel_h / SIXEL_cell_h;
-				SIXEL_mouse_x = (key->params[1] - 1) * SIXEL_pixel_w / SIXEL_cell_w;
-				switch (key->params[0]) {
-				case 0:
-					if (SIXEL_mouse_button & 1) {
-						posted += SDL_PrivateMouseButton(SDL_RELEASED, 1, 0, 0);
-						SIXEL_mouse_button ^= 1;
-					}
-					break;
-				case 1:
-					if (SIXEL_mouse_button & 2) {
-						posted += SDL_PrivateMouseButton(SDL_RELEASED, 2, 0, 0);
-						SIXEL_mouse_button ^= 2;
-					}
-					break;
-				case 2:
-					if (SIXEL_mouse_button & 4) {
-						posted += SDL_PrivateMouseButton(SDL_RELEASED, 3, 0, 0);
-						SIXEL_mouse_button ^= 4;
-					}
-					break;
-				default:
-					break;
+			case 1:
+				if (!(SIXEL_mouse_button & 2)) {
+					posted += SIXEL_PostButton(this, SDL_PRESSED, 2);
+					SIXEL_mouse_button |= 2;
 				}
 				break;
-			case SIXEL_MOUSE_DEC:
-				if (key->nparams >= 4) {
-					SIXEL_mouse_y = key->params[2];
-					SIXEL_mouse_x = key->params[3];
-					//prev_x = prev_y = -1;
-					switch ( key->params[0] ) {
-					case 1:
-						break;
-					case 2:
-						posted += SDL_PrivateMouseButton(SDL_PRESSED, 1, 0, 0);
-						SIXEL_mouse_button |= 1;
-						break;
-					case 3:
-						posted += SDL_PrivateMouseButton(SDL_RELEASED, 1, 0, 0);
-						SIXEL_mouse_button &= ~1;
-						break;
-					case 4:
-						posted += SDL_PrivateMouseButton(SDL_PRESSED, 2, 0, 0);
-						SIXEL_mouse_button |= 2;
-						break;
-					case 5:
-						posted += SDL_PrivateMouseButton(SDL_RELEASED, 2, 0, 0);
-						SIXEL_mouse_button &= ~2;
-						break;
-					case 6:
-						posted += SDL_PrivateMouseButton(SDL_PRESSED, 3, 0, 0);
-						SIXEL_mouse_button |= 4;
-						break;
-					case 7:
-						posted += SDL_PrivateMouseButton(SDL_RELEASED, 3, 0, 0);
-						SIXEL_mouse_button &= ~4;
-						break;
-					case 32:
-					case 64:
-					default:
-						break;
-					}
-					SIXEL_mouse_button = key->params[1];
+			case 2:
+				if (!(SIXEL_mouse_button & 4)) {
+					posted += SIXEL_PostButton(this, SDL_PRESSED, 3);
+					SIXEL_mouse_button |= 4;
 				}
-				printf("\033['|");
-				fflush(stdout);
 				break;
-			case SIXEL_FKEYS:
-				keysym.scancode = key->value;
-				keysym.mod = KMOD_NONE;
-				keysym.unicode = 0;
+			case 33: /* button1 dragging */
+			case 34: /* button2 dragging */
+			case 35: /* button3 dragging */
+			default:
+				break;
+			}
+			break;
+		case SIXEL_MOUSE_SGR_RELEASE:
+			if ( ! SIXEL_MousePosition(this, key) )
+				break;
+			switch (key->params[0]) {
+			case 0:
+				if (SIXEL_mouse_button & 1) {
+					posted += SIXEL_PostButton(this, SDL_RELEASED, 1);
+					SIXEL_mouse_button ^= 1;
+				}
+				break;
+			case 1:
+				if (SIXEL_mouse_button & 2) {
+					posted += SIXEL_PostButton(this, SDL_RELEASED, 2);
+					SIXEL_mouse_button ^= 2;
+				}
+				break;
+			case 2:
+				if (SIXEL_mouse_button & 4) {
+					posted += SIXEL_PostButton(this, SDL_RELEASED, 3);
+					SIXEL_mouse_button ^= 4;
+				}
+				break;
+			default:
+				break;
+			}
+			break;
+		case SIXEL_MOUSE_DEC:
+			if (key->nparams >= 4) {
+				SIXEL_mouse_y = key->params[2];
+				SIXEL_mouse_x = key->params[3];
+				SIXEL_ScalePoint(this, &SIXEL_mouse_x, &SIXEL_mouse_y);
+				//prev_x = prev_y = -1;
 				switch ( key->params[0] ) {
+				case 1:
+					break;
 				case 2:
-					keysym.sym = SDLK_INSERT;
+					posted += SIXEL_PostButton(this, SDL_PRESSED, 1);
+					SIXEL_mouse_button |= 1;
 					break;
 				case 3:
-					keysym.sym = SDLK_DELETE;
+					posted += SIXEL_PostButton(this, SDL_RELEASED, 1);
+					SIXEL_mouse_button &= ~1;
+					break;
+				case 4:
+					posted += SIXEL_PostButton(this, SDL_PRESSED, 2);
+					SIXEL_mouse_button |= 2;
 					break;
 				case 5:
-					keysym.sym = SDLK_PAGEUP;
+					posted += SIXEL_PostButton(this, SDL_RELEASED, 2);
+					SIXEL_mouse_button &= ~2;
 					break;
 				case 6:
-					keysym.sym = SDLK_PAGEDOWN;
+					posted += SIXEL_PostButton(this, SDL_PRESSED, 3);
+					SIXEL_mouse_button |= 4;
 					break;
 				case 7:
-					keysym.sym = SDLK_HOME;  /* RXVT */
-					break;
-				case 8:
-					keysym.sym = SDLK_END;  /* RXVT */
-					break;
-				case 11:
-					keysym.sym = SDLK_F1;  /* RXVT */
-					break;
-				case 12:
-					keysym.sym = SDLK_F2;  /* RXVT */
-					break;
-				case 13:
-					keysym.sym = SDLK_F3;  /* RXVT */
-					break;
-				case 14:
-					keysym.sym = SDLK_F4;  /* RXVT */
-					break;
-				case 15:
-					keysym.sym = SDLK_F5;
-					break;
-				case 17:
-					keysym.sym = SDLK_F6;
-					break;
-				case 18:
-					keysym.sym = SDLK_F7;
-					break;
-				case 19:
-					keysym.sym = SDLK_F8;
-					break;
-				case 20:
-					keysym.sym = SDLK_F9;
-					break;
-				case 21:
-					keysym.sym = SDLK_F10;
-					break;
-				case 23:
-					keysym.sym = SDLK_F11;
-					break;
-				case 24:
-					keysym.sym = SDLK_F12;
+					posted += SIXEL_PostButton(this, SDL_RELEASED, 3);
+					SIXEL_mouse_button &= ~4;
 					break;
+				case 32:
+				case 64:
 				default:
-					keysym.sym = SDLK_UNKNOWN;
 					break;
 				}
+				SIXEL_mouse_button = key->params[1];
+			}
+			SDL_mutexP(SIXEL_mutex);
+			SIXEL_WriteBytes(this, "\033['|", 4);
+			SIXEL_FlushWriter(this);
+			SDL_mutexV(SIXEL_mutex);
+			break;
+		case SIXEL_FKEYS:
+			keysym.scancode = key->value;
+			keysym.mod = KMOD_NONE;
+			keysym.unicode = 0;
+			switch ( key->params[0] ) {
+			case 2:
+				keysym.sym = SDLK_INSERT;
+				break;
+			case 3:
+				keysym.sym = SDLK_DELETE;
+				break;
+			case 5:
+				keysym.sym = SDLK_PAGEUP;
+				break;
+			case 6:
+				keysym.sym = SDLK_PAGEDOWN;
+				break;
+			case 7:
+				keysym.sym = SDLK_HOME;  /* RXVT */
+				break;
+			case 8:
+				keysym.sym = SDLK_END;  /* RXVT */
+				break;
+			case 11:
+				keysym.sym = SDLK_F1;  /* RXVT */
+				break;
+			case 12:
+				keysym.sym = SDLK_F2;  /* RXVT */
+				break;
+			case 13:
+				keysym.sym = SDLK_F3;  /* RXVT */
+				break;
+			case 14:
+				keysym.sym = SDLK_F4;  /* RXVT */
+				break;
+			case 15:
+				keysym.sym = SDLK_F5;
+				break;
+			case 17:
+				keysym.sym = SDLK_F6;
+				break;
+			case 18:
+				keysym.sym = SDLK_F7;
+				break;
+			case 19:
+				keysym.sym = SDLK_F8;
+				break;
+			case 20:
+				keysym.sym = SDLK_F9;
+				break;
+			case 21:
+				keysym.sym = SDLK_F10;
+				break;
+			case 23:
+				keysym.sym = SDLK_F11;
+				break;
+			case 24:
+				keysym.sym = SDLK_F12;
+				break;
+			default:
+				keysym.sym = SDLK_UNKNOWN;
+				break;
+			}
+			keysym.scancode = GetKsymScancode(keysym.sym);
+			if (key->nparams == 2) {
+				key->params[1]--;
+				posted += SendModifierKey(key->params[1], SDL_PRESSED);
+			}
+			posted += SDL_PrivateKeyboard(SDL_PRESSED, &keysym);
+			if (key->nparams == 2) {
+				posted += SendModifierKey(key->params[1], SDL_RELEASED);
+			}
+			posted += SDL_PrivateKeyboard(SDL_RELEASED, &keysym);
+			break;
+		default:
+			if ( (key->value >= SIXEL_UP && key->value <= SIXEL_LEFT) ||
+				(key->value >= SIXEL_END && key->value <= SIXEL_HOME) ||
+				(key->value >= SIXEL_F1 && key->value <= SIXEL_F4) ) {
+				keysym.mod = KMOD_NONE;
+				keysym.unicode = 0;
+				switch(key->value) {
+				case SIXEL_UP: keysym.sym = SDLK_UP; break;
+				case SIXEL_DOWN: keysym.sym = SDLK_DOWN; break;
+				case SIXEL_RIGHT: keysym.sym = SDLK_RIGHT; break;
+				case SIXEL_LEFT: keysym.sym = SDLK_LEFT; break;
+				case SIXEL_HOME: keysym.sym = SDLK_HOME; break;
+				case SIXEL_END: keysym.sym = SDLK_END; break;
+				case SIXEL_F1: keysym.sym = SDLK_F1; break;
+				case SIXEL_F2: keysym.sym = SDLK_F2; break;
+				case SIXEL_F3: keysym.sym = SDLK_F3; break;
+				default: keysym.sym = SDLK_F4; break;
+				}
 				keysym.scancode = GetKsymScancode(keysym.sym);
-				if (key->nparams == 2) {
-					key->params[1]--;
-					posted += SendModifierKey(key->params[1], SDL_PRESSED);
+				if (key->nparams >= 1) {
+					key->params[key->nparams-1]--;
+					posted += SendModifierKey(key->params[key->nparams-1], SDL_PRESSED);
 				}
 				posted += SDL_PrivateKeyboard(SDL_PRESSED, &keysym);
-				if (key->nparams == 2) {
-					posted += SendModifierKey(key->params[1], SDL_RELEASED);
+				if (key->nparams >= 1) {
+					posted += SendModifierKey(key->params[key->nparams-1], SDL_RELEASED);
 				}
 				posted += SDL_PrivateKeyboard(SDL_RELEASED, &keysym);
-				break;
-			default:
-				if ( (key->value >= SIXEL_UP && key->value <= SIXEL_LEFT) ||
-					(key->value >= SIXEL_END && key->value <= SIXEL_HOME) ||
-					(key->value >= SIXEL_F1 && key->value <= SIXEL_F4) ) {
-					keysym.mod = KMOD_NONE;
-					keysym.unicode = 0;
-					switch(key->value) {
-					case SIXEL_UP: keysym.sym = SDLK_UP; break;
-					case SIXEL_DOWN: keysym.sym = SDLK_DOWN; break;
-					case SIXEL_RIGHT: keysym.sym = SDLK_RIGHT; break;
-					case SIXEL_LEFT: keysym.sym = SDLK_LEFT; break;
-					case SIXEL_HOME: keysym.sym = SDLK_HOME; break;
-					case SIXEL_END: keysym.sym = SDLK_END; break;
-					case SIXEL_F1: keysym.sym = SDLK_F1; break;
-					case SIXEL_F2: keysym.sym = SDLK_F2; break;
-					case SIXEL_F3: keysym.sym = SDLK_F3; break;
-					default: keysym.sym = SDLK_F4; break;
-					}
-					keysym.scancode = GetKsymScancode(keysym.sym);
-					if (key->nparams >= 1) {
-						key->params[key->nparams-1]--;
-						posted += SendModifierKey(key->params[key->nparams-1], SDL_PRESSED);
-					}
-					posted += SDL_PrivateKeyboard(SDL_PRESSED, &keysym);
-					if (key->nparams >= 1) {
-						posted += SendModifierKey(key->params[key->nparams-1], SDL_RELEASED);
-					}
-					posted += SDL_PrivateKeyboard(SDL_RELEASED, &keysym);
-				}
-				else {
-					int state = GetState(key->value);
-					if (state) SendModifierKey(state, SDL_PRESSED);
-					posted += SDL_PrivateKeyboard(SDL_PRESSED, TranslateKey(key->value, &keysym));
-					if (state) SendModifierKey(state, SDL_RELEASED);
-					posted += SDL_PrivateKeyboard(SDL_RELEASED, TranslateKey(key->value, &keysym));
-				}
-				break;
 			}
+			else {
+				int state = GetState(key->value);
+				if (state) SendModifierKey(state, SDL_PRESSED);
+				posted += SDL_PrivateKeyboard(SDL_PRESSED, TranslateKey(key->value, &keysym));
+				if (state) SendModifierKey(state, SDL_RELEASED);
+				posted += SDL_PrivateKeyboard(SDL_RELEASED, TranslateKey(key->value, &keysym));
+			}
+			break;
 		}
+		SIXEL_PopKey(this);
 	}
 
-	if ( prev_x != SIXEL_mouse_x || prev_y != SIXEL_mouse_y ) {
-		SDL_Lock_EventThread();
-		SDL_PrivateAppActive(1, SDL_APPMOUSEFOCUS);
-		posted += SDL_PrivateMouseMotion(0, 0, SIXEL_mouse_x, SIXEL_mouse_y);
-		prev_x = SIXEL_mouse_x;
-		prev_y = SIXEL_mouse_y;
-		SDL_Unlock_EventThread();
-	}
+	posted += SIXEL_FlushMotion(this);
 
 #if SIXEL_DEBUG
 	printf("\033[32;1Hevents: %5d button: [%1d] cursor: (%3d, %3d)\n",
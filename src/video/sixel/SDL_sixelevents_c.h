@@ -28,3 +28,7 @@
 extern void SIXEL_PumpEvents(_THIS);
 extern void SIXEL_InitOSKeymap(_THIS);
 
+/* Catch SIGWINCH, so window size changes are asked for and reported */
+extern void SIXEL_WatchResize(_THIS);
+extern void SIXEL_UnwatchResize(_THIS);
+
@@ -0,0 +1,344 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+
+#include "SDL_config.h"
+
+/* Terminal input for the sixel driver.
+
+   A thread blocks on the terminal and parses what it gets into a queue of
+   keys, so input is picked up even while the application is busy or the
+   encoder holds the driver lock, and pumping events only has to go
+   through the queue.  It has a single producer and a single consumer, so
+   the two ends only need to agree on the indices.
+
+   Control sequences are parsed by a small state machine driven by a table
+   indexed by the state and the class of each byte.  Its state is kept in
+   the device and the key being parsed is built right in the first free
+   slot, only handed over once complete, so sequences split between reads
+   survive.
+   When the queue is full the thread stops reading until the consumer
+   wakes it up through a pipe, which is also how it is told to quit.
+*/
+
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+
+#include "SDL.h"
+#include "SDL_thread.h"
+#include "SDL_sixelvideo.h"
+#include "SDL_sixelinput_c.h"
+
+/* Publish writes to the queue before the index moving past them */
+#define SIXEL_Barrier()	__sync_synchronize()
+
+/* Slot of the nth key past those waiting to be pumped */
+#define SIXEL_KEY(n) \
+	(SIXEL_input_queue[(SIXEL_input_head + (n)) & (SIXEL_INPUT_QUEUE - 1)])
+
+/* Parser states, kept per device between reads */
+enum {
+	STATE_GROUND,
+	STATE_ESC,
+	STATE_CSI,
+	STATE_CSI_PARAM
+};
+
+/* Classes of input bytes */
+enum {
+	C_CTL,	/* C0 controls and DEL */
+	C_ESC,	/* ESC */
+	C_INT,	/* Intermediate bytes */
+	C_DIG,	/* Parameter digits */
+	C_SEP,	/* Parameter separators */
+	C_PRI,	/* Private parameter markers */
+	C_INO,	/* 'O' and '[', introducing SS3 and CSI after ESC */
+	C_FIN,	/* Other final bytes */
+	C_HI,	/* Bytes past ASCII */
+	NUM_CLASSES
+};
+
+/* What to do with a byte */
+enum {
+	A_IGNORE,	/* Drop it */
+	A_PRINT,	/* A key of its own */
+	A_ESCAPED,	/* A key following a lone ESC, which is one too */
+	A_CLEAR,	/* Start a control sequence */
+	A_INTER,	/* Collect an intermediate byte */
+	A_PRIVATE,	/* Collect a private marker */
+	A_DIGIT,	/* Add a digit to the current parameter */
+	A_NEXT,		/* Close the current parameter */
+	A_DISPATCH,	/* End a sequence without parameters */
+	A_DISPATCH_PARAM	/* Close the current parameter and end the sequence */
+};
+
+#define T(action, state)	((action) | (STATE_##state) << 4)
+
+static const Uint8 sixel_input_classes[128] = {
+	C_CTL, C_CTL, C_CTL, C_CTL, C_CTL, C_CTL, C_CTL, C_CTL, C_CTL, C_CTL, C_CTL, C_CTL, C_CTL, C_CTL, C_CTL, C_CTL,
+	C_CTL, C_CTL, C_CTL, C_CTL, C_CTL, C_CTL, C_CTL, C_CTL, C_CTL, C_CTL, C_CTL, C_ESC, C_CTL, C_CTL, C_CTL, C_CTL,
+	C_INT, C_INT, C_INT, C_INT, C_INT, C_INT, C_INT, C_INT, C_INT, C_INT, C_INT, C_INT, C_INT, C_INT, C_INT, C_INT,
+	C_DIG, C_DIG, C_DIG, C_DIG, C_DIG, C_DIG, C_DIG, C_DIG, C_DIG, C_DIG, C_SEP, C_SEP, C_PRI, C_PRI, C_PRI, C_PRI,
+	C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_INO,
+	C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_INO, C_FIN, C_FIN, C_FIN, C_FIN,
+	C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN,
+	C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_FIN, C_CTL,
+};
+
+static const Uint8 sixel_input_table[][NUM_CLASSES] = {
+	/* STATE_GROUND */
+	{ T(A_PRINT, GROUND), T(A_IGNORE, ESC), T(A_PRINT, GROUND),
+	  T(A_PRINT, GROUND), T(A_PRINT, GROUND), T(A_PRINT, GROUND),
+	  T(A_PRINT, GROUND), T(A_PRINT, GROUND), T(A_PRINT, GROUND) },
+	/* STATE_ESC */
+	{ T(A_ESCAPED, GROUND), T(A_ESCAPED, GROUND), T(A_ESCAPED, GROUND),
+	  T(A_ESCAPED, GROUND), T(A_ESCAPED, GROUND), T(A_ESCAPED, GROUND),
+	  T(A_CLEAR, CSI), T(A_ESCAPED, GROUND), T(A_ESCAPED, GROUND) },
+	/* STATE_CSI */
+	{ T(A_IGNORE, CSI), T(A_IGNORE, ESC), T(A_INTER, CSI_PARAM),
+	  T(A_DIGIT, CSI_PARAM), T(A_NEXT, CSI_PARAM), T(A_PRIVATE, CSI_PARAM),
+	  T(A_DISPATCH, GROUND), T(A_DISPATCH, GROUND), T(A_IGNORE, GROUND) },
+	/* STATE_CSI_PARAM */
+	{ T(A_IGNORE, CSI_PARAM), T(A_IGNORE, ESC), T(A_INTER, CSI_PARAM),
+	  T(A_DIGIT, CSI_PARAM), T(A_NEXT, CSI_PARAM), T(A_IGNORE, GROUND),
+	  T(A_DISPATCH_PARAM, GROUND), T(A_DISPATCH_PARAM, GROUND), T(A_IGNORE, GROUND) },
+};
+
+#undef T
+
+/* Close the parameter being read, dropping those that don't fit */
+static void SIXEL_NextParam(_THIS, sixel_key_t *key)
+{
+	if ( key->nparams < SDL_arraysize(key->params) ) {
+		key->params[key->nparams++] = SIXEL_input_pbytes;
+	}
+	SIXEL_input_pbytes = 0;
+}
+
+/* Parse input into keys queued right after those already waiting.  The
+   key of a sequence not complete yet sits in the first slot past them.
+   Returns the number of keys completed.
+*/
+static int SIXEL_ParseInput(_THIS, const Uint8 *buf, int nread)
+{
+	int i, c, n, entry;
+	sixel_key_t *key;
+
+	n = 0;
+	for ( i = 0; i < nread; ++i ) {
+		c = buf[i];
+		entry = sixel_input_table[SIXEL_input_state]
+		                         [c < 0x80 ? sixel_input_classes[c] : C_HI];
+		SIXEL_input_state = entry >> 4;
+		key = &SIXEL_KEY(n);
+		switch (entry & 0x0f) {
+		case A_IGNORE:
+			break;
+		case A_ESCAPED:
+			key->value = 0x1b;
+			key->nparams = 0;
+			key = &SIXEL_KEY(++n);
+			/* Fall through */
+		case A_PRINT:
+			key->value = c;
+			key->nparams = 0;
+			++n;
+			break;
+		case A_CLEAR:
+			key->nparams = 0;
+			key->params[0] = 0;
+			SIXEL_input_ibytes = 0;
+			SIXEL_input_pbytes = 0;
+			break;
+		case A_INTER:
+			SIXEL_input_ibytes |= c - 0x1f;
+			break;
+		case A_PRIVATE:
+			SIXEL_input_ibytes = (c - ';') << 4;
+			break;
+		case A_DIGIT:
+			if ( SIXEL_input_pbytes < 100000 ) {
+				SIXEL_input_pbytes = SIXEL_input_pbytes * 10 + c - '0';
+			}
+			break;
+		case A_NEXT:
+			SIXEL_NextParam(this, key);
+			break;
+		case A_DISPATCH_PARAM:
+			SIXEL_NextParam(this, key);
+			/* Fall through */
+		case A_DISPATCH:
+			key->value = 1 << 12 | SIXEL_input_ibytes << 6 | (c - '@');
+			++n;
+			break;
+		}
+	}
+	return(n);
+}
+
+/* Read and parse what the terminal sent, waiting up to timeout ms for it.
+   Returns -1 once the terminal is gone.
+*/
+static int SIXEL_ReadInput(_THIS, int timeout)
+{
+	struct pollfd fds[2];
+	Uint8 buf[4096];
+	int room, nfds, nread, nkeys;
+
+	/* A byte gives at most two keys, and the partial one needs a slot */
+	room = (SIXEL_INPUT_QUEUE - 1 - (int)(SIXEL_input_head - SIXEL_input_tail)) / 2;
+	if ( room <= 0 && SIXEL_input_wake[0] >= 0 ) {
+		SIXEL_input_stalled = 1;
+		SIXEL_Barrier();
+		room = (SIXEL_INPUT_QUEUE - 1 - (int)(SIXEL_input_head - SIXEL_input_tail)) / 2;
+		if ( room > 0 ) {
+			SIXEL_input_stalled = 0;
+		}
+	}
+
+	nfds = 0;
+	if ( room > 0 ) {
+		fds[nfds].fd = STDIN_FILENO;
+		fds[nfds].events = POLLIN;
+		++nfds;
+	}
+	if ( SIXEL_input_wake[0] >= 0 ) {
+		fds[nfds].fd = SIXEL_input_wake[0];
+		fds[nfds].events = POLLIN;
+		++nfds;
+	}
+	if ( nfds == 0 || poll(fds, nfds, timeout) <= 0 ) {
+		return(0);
+	}
+	if ( fds[nfds-1].fd == SIXEL_input_wake[0] && fds[nfds-1].revents ) {
+		while ( read(SIXEL_input_wake[0], buf, sizeof(buf)) > 0 ) {
+			/* Just draining */
+		}
+		SIXEL_input_stalled = 0;
+	}
+	if ( room <= 0 || ! fds[0].revents ) {
+		return(0);
+	}
+
+	nread = read(STDIN_FILENO, buf, SDL_min(room, (int)sizeof(buf)));
+	if ( nread == 0 || (nread < 0 && errno != EINTR && errno != EAGAIN) ) {
+		return(-1);
+	}
+	if ( nread < 0 ) {
+		return(0);
+	}
+	nkeys = SIXEL_ParseInput(this, buf, nread);
+	SIXEL_Barrier();
+	SIXEL_input_head += nkeys;
+	return(nread);
+}
+
+static int SIXEL_InputThread(_THIS)
+{
+	while ( ! SIXEL_input_quit ) {
+		if ( SIXEL_ReadInput(this, -1) < 0 ) {
+			break;
+		}
+	}
+	return(0);
+}
+
+int SIXEL_StartInput(_THIS)
+{
+	const char *envr;
+
+	SIXEL_input_head = 0;
+	SIXEL_input_tail = 0;
+	SIXEL_input_state = STATE_GROUND;
+	SIXEL_input_stalled = 0;
+	SIXEL_input_quit = 0;
+	SIXEL_input_wake[0] = -1;
+	SIXEL_input_wake[1] = -1;
+
+	/* Without the thread, input is read when events are pumped */
+	envr = SDL_getenv("SDL_SIXEL_INPUT_THREAD");
+	if ( envr && ! SDL_atoi(envr) ) {
+		return(0);
+	}
+	if ( pipe(SIXEL_input_wake) < 0 ) {
+		SIXEL_input_wake[0] = -1;
+		SIXEL_input_wake[1] = -1;
+		return(0);
+	}
+	fcntl(SIXEL_input_wake[0], F_SETFL, O_NONBLOCK);
+	fcntl(SIXEL_input_wake[1], F_SETFL, O_NONBLOCK);
+	SIXEL_input_thread = SDL_CreateThread(
+		(int (*)(void *))SIXEL_InputThread, this);
+	if ( ! SIXEL_input_thread ) {
+		/* Read input when events are pumped instead, as if the
+		   thread had been turned off.  The key queue is part of the
+		   device, emptying it is all it takes. */
+		close(SIXEL_input_wake[0]);
+		close(SIXEL_input_wake[1]);
+		SIXEL_input_wake[0] = -1;
+		SIXEL_input_wake[1] = -1;
+		SIXEL_input_head = 0;
+		SIXEL_input_tail = 0;
+	}
+	return(0);
+}
+
+void SIXEL_StopInput(_THIS)
+{
+	if ( SIXEL_input_thread ) {
+		SIXEL_input_quit = 1;
+		write(SIXEL_input_wake[1], "", 1);
+		SDL_WaitThread(SIXEL_input_thread, NULL);
+		SIXEL_input_thread = NULL;
+	}
+	if ( SIXEL_input_wake[0] >= 0 ) {
+		close(SIXEL_input_wake[0]);
+		close(SIXEL_input_wake[1]);
+		SIXEL_input_wake[0] = -1;
+		SIXEL_input_wake[1] = -1;
+	}
+}
+
+sixel_key_t *SIXEL_PeekKey(_THIS)
+{
+	if ( ! SIXEL_input_thread && SIXEL_input_tail == SIXEL_input_head ) {
+		SIXEL_ReadInput(this, 0);
+	}
+	if ( SIXEL_input_tail == SIXEL_input_head ) {
+		return(NULL);
+	}
+	SIXEL_Barrier();
+	return(&SIXEL_input_queue[SIXEL_input_tail & (SIXEL_INPUT_QUEUE - 1)]);
+}
+
+void SIXEL_PopKey(_THIS)
+{
+	SIXEL_Barrier();
+	++SIXEL_input_tail;
+	SIXEL_Barrier();
+	if ( SIXEL_input_stalled ) {
+		SIXEL_input_stalled = 0;
+		write(SIXEL_input_wake[1], "", 1);
+	}
+}
@@ -0,0 +1,38 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+
+
+#include "SDL_sixelvideo.h"
+
+/* Functions exported by SDL_sixelinput.c to the rest of the sixel driver */
+
+/* Start reading the terminal, in a thread unless SDL_SIXEL_INPUT_THREAD=0
+   or the thread can't be started
+*/
+extern int SIXEL_StartInput(_THIS);
+extern void SIXEL_StopInput(_THIS);
+
+/* Get the next key sent by the terminal, or NULL if there is none yet.
+   It stays valid until SIXEL_PopKey() is called.
+*/
+extern sixel_key_t *SIXEL_PeekKey(_THIS);
+extern void SIXEL_PopKey(_THIS);
@@ -0,0 +1,377 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+
+#include "SDL_config.h"
+
+/* Pointer for the sixel driver.
+
+   SDL draws its own cursor into the framebuffer, so every move of the
+   mouse dirties the cells around it and has them encoded again with the
+   next frame.  Here the cursor stays out of the framebuffer instead: the
+   few cells under it are sent as an image of their own with the cursor
+   drawn over them, and when it moves, only the cells it no longer covers
+   are sent again from the framebuffer.  Frames painting over the pointer
+   have it sent again right after them.
+
+   With SDL_SIXEL_CURSOR=terminal nothing is drawn at all, and the pointer
+   of the terminal itself stands in for the one of the application.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL_mouse.h"
+#include "SDL_sixelvideo.h"
+#include "SDL_sixelmouse_c.h"
+#include "SDL_sixelrects_c.h"
+#include "SDL_sixelscroll_c.h"
+#include "SDL_sixelwriter_c.h"
+
+/* The implementation dependent data for the window manager cursor */
+struct WMcursor {
+	int w, h;
+	int hot_x, hot_y;
+	Uint8 *data;
+	Uint8 *mask;
+};
+
+/* Work out the cells the pointer covers at its current position */
+static void SIXEL_CursorCells(_THIS, SDL_Rect *cells)
+{
+	WMcursor *cursor = SIXEL_cursor;
+	int x1, y1, x2, y2;
+
+	cells->x = 0;
+	cells->y = 0;
+	cells->w = 0;
+	cells->h = 0;
+	if ( ! cursor || SIXEL_cursor_terminal || SIXEL_scale_cell_h == 0 ) {
+		return;
+	}
+	x1 = SDL_max(SIXEL_cursor_x - cursor->hot_x, 0);
+	y1 = SDL_max(SIXEL_cursor_y - cursor->hot_y, 0);
+	x2 = SDL_min(SIXEL_cursor_x - cursor->hot_x + cursor->w, SIXEL_w);
+	y2 = SDL_min(SIXEL_cursor_y - cursor->hot_y + cursor->h, SIXEL_h);
+	if ( x1 >= x2 || y1 >= y2 ) {
+		return;
+	}
+	cells->x = x1;
+	cells->y = y1;
+	cells->w = x2 - x1;
+	cells->h = y2 - y1;
+	SIXEL_SnapRect(this, cells);
+}
+
+/* The palette entry closest to a gray level, for 8-bit screens */
+static int SIXEL_CursorColor(_THIS, int level)
+{
+	int i, d, best = 0, best_d = 3 * 256;
+
+	for ( i = 0; i < 256; ++i ) {
+		d = SDL_abs(SIXEL_palette[i * 3] - level) +
+		    SDL_abs(SIXEL_palette[i * 3 + 1] - level) +
+		    SDL_abs(SIXEL_palette[i * 3 + 2] - level);
+		if ( d < best_d ) {
+			best = i;
+			best_d = d;
+		}
+	}
+	return(best);
+}
+
+/* Send the cells under the pointer with the pointer drawn over them.  The
+   framebuffer is read as it is now, which on the encoder thread may be
+   ahead of the frame just sent; the next frame puts that right.  The
+   cells are copied into a buffer of their own size first.
+*/
+static void SIXEL_DrawCursor(_THIS, const SDL_Rect *cells)
+{
+	WMcursor *cursor = SIXEL_cursor;
+	int pitch = cells->w * SIXEL_bpp;
+	int x, y, row, col, bit;
+	int black, white;
+	Uint8 *dst;
+
+	if ( SIXEL_cursor_size < cells->h * pitch ) {
+		dst = (Uint8 *)realloc(SIXEL_cursor_pixels, cells->h * pitch);
+		if ( ! dst ) {
+			return;
+		}
+		SIXEL_cursor_pixels = dst;
+		SIXEL_cursor_size = cells->h * pitch;
+	}
+	for ( y = 0; y < cells->h; ++y ) {
+		memcpy(SIXEL_cursor_pixels + y * pitch,
+		       SIXEL_buffer + (cells->y + y) * SIXEL_w * SIXEL_bpp +
+		       cells->x * SIXEL_bpp, pitch);
+	}
+
+	if ( SIXEL_bpp == 1 ) {
+		black = SIXEL_CursorColor(this, 0);
+		white = SIXEL_CursorColor(this, 255);
+	} else {
+		black = 0x00;
+		white = 0xff;
+	}
+	for ( row = 0; row < cursor->h; ++row ) {
+		y = SIXEL_cursor_y - cursor->hot_y + row;
+		if ( y < cells->y || y >= cells->y + cells->h ) {
+			continue;
+		}
+		for ( col = 0; col < cursor->w; ++col ) {
+			x = SIXEL_cursor_x - cursor->hot_x + col;
+			if ( x < cells->x || x >= cells->x + cells->w ) {
+				continue;
+			}
+			/* Black where there is data, white where only the mask
+			   is set, and the inverted pixels come out black */
+			bit = (row * cursor->w + col);
+			if ( cursor->data[bit / 8] & (0x80 >> (bit % 8)) ) {
+				dst = SIXEL_cursor_pixels + (y - cells->y) * pitch +
+				      (x - cells->x) * SIXEL_bpp;
+				memset(dst, black, SIXEL_bpp);
+			} else if ( cursor->mask[bit / 8] & (0x80 >> (bit % 8)) ) {
+				dst = SIXEL_cursor_pixels + (y - cells->y) * pitch +
+				      (x - cells->x) * SIXEL_bpp;
+				memset(dst, white, SIXEL_bpp);
+			}
+		}
+	}
+	SIXEL_EncodeRect(this, SIXEL_cursor_pixels, pitch, cells);
+}
+
+/* Send the cells the pointer covered and no longer does */
+static void SIXEL_RestoreCells(_THIS, const SDL_Rect *old, const SDL_Rect *cur)
+{
+	SDL_Rect parts[4];
+	int pitch = SIXEL_w * SIXEL_bpp;
+	int i, n = 0;
+	int y1, y2;
+
+	if ( old->w == 0 ) {
+		return;
+	}
+	if ( SIXEL_cursor_cell_w != SIXEL_scale_cell_w ||
+	     SIXEL_cursor_cell_h != SIXEL_scale_cell_h ) {
+		/* The cells changed size, the whole screen gets sent anyway */
+		return;
+	}
+	if ( cur->w == 0 ||
+	     old->x >= cur->x + cur->w || cur->x >= old->x + old->w ||
+	     old->y >= cur->y + cur->h || cur->y >= old->y + old->h ) {
+		parts[n++] = *old;
+	} else {
+		/* What is left of the old cells above, below and beside */
+		y1 = SDL_max(old->y, cur->y);
+		y2 = SDL_min(old->y + old->h, cur->y + cur->h);
+		if ( old->y < y1 ) {
+			parts[n].x = old->x;
+			parts[n].y = old->y;
+			parts[n].w = old->w;
+			parts[n].h = y1 - old->y;
+			++n;
+		}
+		if ( old->y + old->h > y2 ) {
+			parts[n].x = old->x;
+			parts[n].y = y2;
+			parts[n].w = old->w;
+			parts[n].h = old->y + old->h - y2;
+			++n;
+		}
+		if ( old->x < cur->x ) {
+			parts[n].x = old->x;
+			parts[n].y = y1;
+			parts[n].w = cur->x - old->x;
+			parts[n].h = y2 - y1;
+			++n;
+		}
+		if ( old->x + old->w > cur->x + cur->w ) {
+			parts[n].x = cur->x + cur->w;
+			parts[n].y = y1;
+			parts[n].w = old->x + old->w - parts[n].x;
+			parts[n].h = y2 - y1;
+			++n;
+		}
+	}
+	for ( i = 0; i < n; ++i ) {
+		SIXEL_EncodeRect(this, SIXEL_buffer + parts[i].y * pitch +
+		                 parts[i].x * SIXEL_bpp, pitch, &parts[i]);
+	}
+}
+
+/* Bring what the terminal shows in line with the pointer */
+static void SIXEL_UpdateCursor(_THIS)
+{
+	SDL_Rect cells;
+
+	SIXEL_CursorCells(this, &cells);
+	SIXEL_RestoreCells(this, &SIXEL_cursor_cells, &cells);
+	if ( cells.w > 0 ) {
+		SIXEL_DrawCursor(this, &cells);
+	}
+	SIXEL_cursor_cells = cells;
+	SIXEL_cursor_cell_w = SIXEL_scale_cell_w;
+	SIXEL_cursor_cell_h = SIXEL_scale_cell_h;
+	SIXEL_cursor_dirty = 0;
+}
+
+/* Update the pointer now, unless the terminal is behind with the frames */
+static void SIXEL_SendCursor(_THIS)
+{
+	SDL_mutexP(SIXEL_mutex);
+	SIXEL_cursor_dirty = 1;
+	if ( SIXEL_FlushWriter(this) <= SIXEL_MAX_PENDING ) {
+		SIXEL_UpdateCursor(this);
+		SIXEL_FlushWriter(this);
+	}
+	SDL_mutexV(SIXEL_mutex);
+}
+
+void SIXEL_FreeWMCursor(_THIS, WMcursor *cursor)
+{
+	SDL_mutexP(SIXEL_mutex);
+	if ( SIXEL_cursor == cursor ) {
+		SIXEL_cursor = NULL;
+	}
+	SDL_mutexV(SIXEL_mutex);
+	SDL_free(cursor->data);
+	SDL_free(cursor);
+}
+
+WMcursor *SIXEL_CreateWMCursor(_THIS,
+		Uint8 *data, Uint8 *mask, int w, int h, int hot_x, int hot_y)
+{
+	WMcursor *cursor;
+	int len = (w / 8) * h;
+
+	cursor = (WMcursor *)SDL_malloc(sizeof(*cursor));
+	if ( cursor ) {
+		cursor->data = (Uint8 *)SDL_malloc(len * 2);
+		if ( ! cursor->data ) {
+			SDL_free(cursor);
+			cursor = NULL;
+		}
+	}
+	if ( ! cursor ) {
+		SDL_OutOfMemory();
+		return(NULL);
+	}
+	cursor->w = w;
+	cursor->h = h;
+	cursor->hot_x = hot_x;
+	cursor->hot_y = hot_y;
+	cursor->mask = cursor->data + len;
+	SDL_memcpy(cursor->data, data, len);
+	SDL_memcpy(cursor->mask, mask, len);
+	return(cursor);
+}
+
+int SIXEL_ShowWMCursor(_THIS, WMcursor *cursor)
+{
+	int x, y;
+
+	if ( ! SIXEL_buffer ) {
+		/* No video mode yet, the cursor is shown again once set */
+		SIXEL_cursor = cursor;
+		return(1);
+	}
+	SDL_GetMouseState(&x, &y);
+	SDL_mutexP(SIXEL_mutex);
+	SIXEL_cursor = cursor;
+	SIXEL_cursor_x = x;
+	SIXEL_cursor_y = y;
+	SDL_mutexV(SIXEL_mutex);
+	SIXEL_SendCursor(this);
+	return(1);
+}
+
+void SIXEL_MoveWMCursor(_THIS, int x, int y)
+{
+	if ( x == SIXEL_cursor_x && y == SIXEL_cursor_y ) {
+		return;
+	}
+	SDL_mutexP(SIXEL_mutex);
+	SIXEL_cursor_x = x;
+	SIXEL_cursor_y = y;
+	SDL_mutexV(SIXEL_mutex);
+	if ( SIXEL_cursor ) {
+		SIXEL_SendCursor(this);
+	}
+}
+
+void SIXEL_RepaintCursor(_THIS, int numrects, SDL_Rect *rects)
+{
+	SDL_Rect *cells = &SIXEL_cursor_cells;
+	int i;
+
+	if ( ! SIXEL_cursor_dirty ) {
+		if ( cells->w == 0 ) {
+			return;
+		}
+		for ( i = 0; i < numrects; ++i ) {
+			if ( rects[i].x < cells->x + cells->w &&
+			     cells->x < rects[i].x + rects[i].w &&
+			     rects[i].y < cells->y + cells->h &&
+			     cells->y < rects[i].y + rects[i].h ) {
+				break;
+			}
+		}
+		if ( i == numrects ) {
+			return;
+		}
+	}
+	SIXEL_UpdateCursor(this);
+}
+
+int SIXEL_ScrollCursor(_THIS, int numrects, SDL_Rect *rects, SDL_Rect **result)
+{
+	SDL_Rect cells;
+	int n;
+
+	SDL_mutexP(SIXEL_mutex);
+	cells = SIXEL_cursor_cells;
+	SDL_mutexV(SIXEL_mutex);
+	if ( SIXEL_nscrolls == 0 || cells.w == 0 ) {
+		*result = rects;
+		return(numrects);
+	}
+
+	/* The terminal moves the pointer along with the picture */
+	n = 0;
+	SIXEL_AddRects(SIXEL_cursor_rects, &n, numrects, rects);
+	SIXEL_ScrollRects(this, SIXEL_nscrolls, SIXEL_scrolls, 1, &cells);
+	SIXEL_AddRects(SIXEL_cursor_rects, &n, 1, &cells);
+	*result = SIXEL_cursor_rects;
+	return(n);
+}
+
+void SIXEL_FreeCursor(_THIS)
+{
+	if ( SIXEL_cursor_pixels ) {
+		free(SIXEL_cursor_pixels);
+		SIXEL_cursor_pixels = NULL;
+	}
+	SIXEL_cursor_size = 0;
+	SIXEL_cursor_cells.w = 0;
+	SIXEL_cursor_cells.h = 0;
+	SIXEL_cursor_dirty = 1;
+}
@@ -0,0 +1,45 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+
+
+#include "SDL_sixelvideo.h"
+
+/* Functions exported by SDL_sixelmouse.c to the rest of the sixel driver */
+
+extern void SIXEL_FreeWMCursor(_THIS, WMcursor *cursor);
+extern WMcursor *SIXEL_CreateWMCursor(_THIS,
+		Uint8 *data, Uint8 *mask, int w, int h, int hot_x, int hot_y);
+extern int SIXEL_ShowWMCursor(_THIS, WMcursor *cursor);
+extern void SIXEL_MoveWMCursor(_THIS, int x, int y);
+
+/* Send the pointer again if it moved while the terminal was busy, or if
+   any of the rectangles just encoded painted over it.  Call with the
+   output lock held.
+*/
+extern void SIXEL_RepaintCursor(_THIS, int numrects, SDL_Rect *rects);
+
+/* Add the cells the pointer is scrolled to, along with those it leaves,
+   to the update rectangles of a frame carrying scrolls.  Returns the
+   number of rectangles stored in *result.
+*/
+extern int SIXEL_ScrollCursor(_THIS, int numrects, SDL_Rect *rects, SDL_Rect **result);
+extern void SIXEL_FreeCursor(_THIS);
@@ -0,0 +1,122 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+
+#include "SDL_config.h"
+
+/* Adaptive frame pacing for the sixel driver.
+
+   Frames are spaced at least 1/SDL_SIXEL_FPS seconds apart, or as far
+   apart as it takes to encode one if that is longer.  The drain rate of
+   the terminal is measured whenever output had to wait, and a frame is
+   held back as long as the backlog would take more than a frame interval
+   to drain.  Held back updates are merged into the next frame that goes
+   out, so over a slow link the picture skips ahead instead of lagging
+   further and further behind the input.
+*/
+
+#include "SDL.h"
+#include "SDL_sixelvideo.h"
+#include "SDL_sixelpacing_c.h"
+
+void SIXEL_InitPacing(_THIS, int fps)
+{
+	SIXEL_fps = fps;
+	SIXEL_frame_interval = fps > 0 ? 1000000 / fps : 0;
+	SIXEL_next_frame = 0;
+	SIXEL_encode_time = 0;
+	SIXEL_last_flush = SIXEL_GetMicroseconds();
+	SIXEL_drain_rate = 0;
+	SIXEL_rate_start = SIXEL_last_flush;
+	SIXEL_rate_frames = 0;
+	SIXEL_effective_fps = 0;
+}
+
+int SIXEL_PaceFrame(_THIS, int pending)
+{
+	Uint64 now = SIXEL_GetMicroseconds();
+
+	if ( now < SIXEL_next_frame ) {
+		return(0);
+	}
+	if ( pending > 0 ) {
+		if ( SIXEL_drain_rate == 0 ) {
+			/* No measurement yet, fall back to the plain size limit */
+			return(pending <= SIXEL_MAX_PENDING);
+		}
+		if ( (Uint64)pending * 1000000 / SIXEL_drain_rate > SIXEL_frame_interval ) {
+			return(0);
+		}
+	}
+	return(1);
+}
+
+Uint32 SIXEL_PaceDelay(_THIS)
+{
+	Uint64 now = SIXEL_GetMicroseconds();
+
+	if ( now >= SIXEL_next_frame ) {
+		return(0);
+	}
+	return (Uint32)(SIXEL_next_frame - now);
+}
+
+void SIXEL_PaceEncoded(_THIS, Uint64 start)
+{
+	Uint64 now = SIXEL_GetMicroseconds();
+	Uint64 elapsed = now - start;
+
+	if ( SIXEL_encode_time == 0 ) {
+		SIXEL_encode_time = elapsed;
+	} else {
+		SIXEL_encode_time = (SIXEL_encode_time * 3 + elapsed) / 4;
+	}
+	SIXEL_next_frame = start + SDL_max(SIXEL_frame_interval, SIXEL_encode_time);
+
+	++SIXEL_rate_frames;
+	if ( now - SIXEL_rate_start >= 1000000 ) {
+		SIXEL_effective_fps = (int)((Uint64)SIXEL_rate_frames * 1000000 /
+		                            (now - SIXEL_rate_start));
+		SIXEL_rate_start = now;
+		SIXEL_rate_frames = 0;
+	}
+}
+
+void SIXEL_PaceWritten(_THIS, int written, int backlog)
+{
+	Uint64 now = SIXEL_GetMicroseconds();
+	Uint64 elapsed = now - SIXEL_last_flush;
+	Uint32 rate;
+
+	SIXEL_last_flush = now;
+
+	/* Only intervals where the terminal was busy all along tell how
+	   fast it can go */
+	if ( backlog <= 0 || elapsed == 0 ) {
+		return;
+	}
+	rate = (Uint32)((Uint64)written * 1000000 / elapsed);
+	if ( SIXEL_drain_rate == 0 ) {
+		SIXEL_drain_rate = rate;
+	} else {
+		SIXEL_drain_rate = (SIXEL_drain_rate * 7 + rate) / 8;
+	}
+}
@@ -0,0 +1,41 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+
+
+#include "SDL_sixelvideo.h"
+
+/* Functions exported by SDL_sixelpacing.c to the rest of the sixel driver.
+   Pacing is only active when SDL_SIXEL_FPS sets a target frame rate.
+*/
+extern void SIXEL_InitPacing(_THIS, int fps);
+
+/* Whether a frame may be encoded now, given the output backlog */
+extern int SIXEL_PaceFrame(_THIS, int pending);
+
+/* Microseconds left until the next frame is due */
+extern Uint32 SIXEL_PaceDelay(_THIS);
+
+/* Account for a frame whose encoding started at the given time */
+extern void SIXEL_PaceEncoded(_THIS, Uint64 start);
+
+/* Account for bytes the terminal took while backlog bytes were waiting */
+extern void SIXEL_PaceWritten(_THIS, int written, int backlog);
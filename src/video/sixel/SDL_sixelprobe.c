@@ -0,0 +1,315 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+
+#include "SDL_config.h"
+
+/* Terminal capability probe.
+
+   At startup the terminal is asked for its number of color registers and
+   the largest sixel image it takes (XTSMGRAPHICS), whether it reports the
+   mouse in pixels (DECRQM for mode 1016) and, last, for its primary device
+   attributes (DA1), which say whether it has sixel graphics at all.  Every
+   terminal answers DA1 and answers come in order, so the DA1 answer ends
+   the probe.
+
+   What was found is then written to a profile named after $TERM (and
+   $TERM_PROGRAM, which tells apart terminals sharing a TERM) in
+   $XDG_CACHE_HOME/SDL_sixel, or ~/.cache/SDL_sixel, and later launches
+   read it back instead of waiting for the terminal.  The profile is plain
+   "name=value" lines and may be edited or removed to probe again.
+   SDL_SIXEL_PROFILE names another profile file, or disables profiles
+   when empty, and SDL_SIXEL_PROBE=0 skips all this and assumes a 256
+   color sixel terminal.
+
+   The size of the window changes from one launch to the next, so it is
+   asked for every time, for the driver to offer video modes that fit.
+   With a profile that is all there is to ask, followed by DA1 so the
+   wait ends as soon as the terminal has answered.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "SDL.h"
+#include "SDL_sixelvideo.h"
+#include "SDL_sixelprobe_c.h"
+#include "SDL_sixelinput_c.h"
+#include "SDL_sixelwriter_c.h"
+
+/* How long to wait for a terminal that doesn't answer, in milliseconds */
+#define SIXEL_PROBE_TIMEOUT	1000
+
+static int SIXEL_ProfilePath(char *path, int len)
+{
+	const char *envr, *term, *program;
+	char name[256];
+	char *p;
+
+	envr = SDL_getenv("SDL_SIXEL_PROFILE");
+	if ( envr ) {
+		if ( ! *envr ) {
+			return(-1);
+		}
+		SDL_snprintf(path, len, "%s", envr);
+		return(0);
+	}
+
+	term = SDL_getenv("TERM");
+	if ( ! term || ! *term ) {
+		return(-1);
+	}
+	program = SDL_getenv("TERM_PROGRAM");
+	if ( program && *program ) {
+		SDL_snprintf(name, sizeof(name), "%s-%s", term, program);
+	} else {
+		SDL_snprintf(name, sizeof(name), "%s", term);
+	}
+	for ( p = name; *p; ++p ) {
+		if ( *p == '/' ) {
+			*p = '_';
+		}
+	}
+
+	envr = SDL_getenv("XDG_CACHE_HOME");
+	if ( envr && *envr ) {
+		SDL_snprintf(path, len, "%s/SDL_sixel/%s", envr, name);
+	} else if ( (envr = SDL_getenv("HOME")) != NULL && *envr ) {
+		SDL_snprintf(path, len, "%s/.cache/SDL_sixel/%s", envr, name);
+	} else {
+		return(-1);
+	}
+	return(0);
+}
+
+static int SIXEL_LoadProfile(_THIS, const char *path)
+{
+	FILE *fp;
+	char line[128];
+	int value, w, h;
+
+	fp = fopen(path, "r");
+	if ( ! fp ) {
+		return(-1);
+	}
+	while ( fgets(line, sizeof(line), fp) ) {
+		if ( sscanf(line, "sixel=%d", &value) == 1 ) {
+			SIXEL_term_sixel = value;
+		} else if ( sscanf(line, "colors=%d", &value) == 1 ) {
+			SIXEL_term_colors = value;
+		} else if ( sscanf(line, "geometry=%dx%d", &w, &h) == 2 ) {
+			SIXEL_term_max_w = w;
+			SIXEL_term_max_h = h;
+		} else if ( sscanf(line, "mouse_pixels=%d", &value) == 1 ) {
+			SIXEL_term_mouse_pixels = value;
+		}
+	}
+	fclose(fp);
+	return(0);
+}
+
+static void SIXEL_SaveProfile(_THIS)
+{
+	FILE *fp;
+	char path[1024], temp[1040];
+	char *p;
+
+	if ( SIXEL_ProfilePath(path, sizeof(path)) < 0 ) {
+		return;
+	}
+	/* Make the cache directories, if they aren't there yet */
+	for ( p = strchr(path + 1, '/'); p; p = strchr(p + 1, '/') ) {
+		*p = '\0';
+		if ( mkdir(path, 0755) < 0 && errno != EEXIST ) {
+			return;
+		}
+		*p = '/';
+	}
+
+	/* Several programs may start at once, replace the profile in one go */
+	SDL_snprintf(temp, sizeof(temp), "%s.%d", path, (int)getpid());
+	fp = fopen(temp, "w");
+	if ( ! fp ) {
+		return;
+	}
+	fprintf(fp, "sixel=%d\n", SIXEL_term_sixel);
+	fprintf(fp, "colors=%d\n", SIXEL_term_colors);
+	fprintf(fp, "geometry=%dx%d\n", SIXEL_term_max_w, SIXEL_term_max_h);
+	fprintf(fp, "mouse_pixels=%d\n", SIXEL_term_mouse_pixels);
+	if ( fclose(fp) != 0 || rename(temp, path) < 0 ) {
+		remove(temp);
+	}
+}
+
+/* Turn on what the terminal was found to support */
+static void SIXEL_ApplyProbe(_THIS)
+{
+	const char *envr;
+
+	envr = SDL_getenv("SDL_SIXEL_MOUSE_PIXELS");
+	if ( SIXEL_term_mouse_pixels && ! SIXEL_mouse_pixels &&
+	     (! envr || SDL_atoi(envr)) ) {
+		SDL_mutexP(SIXEL_mutex);
+		SIXEL_WriteBytes(this, "\033[?1016h", 8);
+		SIXEL_FlushWriter(this);
+		SDL_mutexV(SIXEL_mutex);
+		SIXEL_mouse_pixels = 1;
+	}
+}
+
+int SIXEL_ProbeReply(_THIS, sixel_key_t *key)
+{
+	int i;
+
+	switch (key->value) {
+	case SIXEL_REPLY_XTSMGRAPHICS:
+		/* Item, status (0 is success), then the value */
+		if ( key->nparams < 3 || key->params[1] != 0 ) {
+			break;
+		}
+		if ( key->params[0] == 1 ) {
+			SIXEL_term_colors = key->params[2];
+		} else if ( key->params[0] == 2 && key->nparams >= 4 ) {
+			SIXEL_term_max_w = key->params[2];
+			SIXEL_term_max_h = key->params[3];
+		}
+		break;
+	case SIXEL_REPLY_DECRPM:
+		/* Set or reset means it is known, permanently set counts too */
+		if ( key->nparams >= 2 && key->params[0] == 1016 ) {
+			SIXEL_term_mouse_pixels = (key->params[1] >= 1 &&
+			                           key->params[1] <= 3);
+		}
+		break;
+	case SIXEL_REPLY_DA1:
+		/* The device class comes first, then the extensions */
+		SIXEL_term_sixel = 0;
+		for ( i = 1; i < key->nparams; ++i ) {
+			if ( key->params[i] == 4 ) {
+				SIXEL_term_sixel = 1;
+			}
+		}
+		if ( SIXEL_probe_pending ) {
+			SIXEL_probe_pending = 0;
+			SIXEL_SaveProfile(this);
+			SIXEL_ApplyProbe(this);
+		}
+		break;
+	default:
+		return(0);
+	}
+	return(1);
+}
+
+/* Whether answers can be waited for at all */
+static int SIXEL_CanProbe(_THIS)
+{
+	const char *envr;
+
+	/* Answers can only be read from the terminal itself */
+	envr = SDL_getenv("SDL_SIXEL_PROBE");
+	if ( (envr && ! SDL_atoi(envr)) || SIXEL_headless ||
+	     ! isatty(STDIN_FILENO) ) {
+		return(0);
+	}
+	return(1);
+}
+
+/* Wait for the answers up to the one to DA1, which comes last.  The size
+   of the window in pixels is picked up on the way.
+*/
+static void SIXEL_AwaitProbe(_THIS)
+{
+	sixel_key_t *key;
+	Uint32 deadline;
+	int done = 0;
+
+	deadline = SDL_GetTicks() + SIXEL_PROBE_TIMEOUT;
+	while ( ! done && (Sint32)(deadline - SDL_GetTicks()) > 0 ) {
+		key = SIXEL_PeekKey(this);
+		if ( ! key ) {
+			SDL_Delay(1);
+			continue;
+		}
+		if ( key->value == SIXEL_DTTERM_SEQS &&
+		     key->params[0] == 4 && key->nparams >= 3 ) {
+			SIXEL_term_pixel_h = key->params[1];
+			SIXEL_term_pixel_w = key->params[2];
+		} else if ( ! SIXEL_ProbeReply(this, key) ) {
+			/* Something was typed meanwhile, SIXEL_PumpEvents
+			   takes care of it and of the remaining answers */
+			break;
+		}
+		done = (key->value == SIXEL_REPLY_DA1);
+		SIXEL_PopKey(this);
+	}
+}
+
+int SIXEL_ProbeTerminal(_THIS)
+{
+	char path[1024];
+
+	/* What the driver assumed before it asked */
+	SIXEL_probe_pending = 0;
+	SIXEL_term_sixel = 1;
+	SIXEL_term_colors = 256;
+	SIXEL_term_max_w = 0;
+	SIXEL_term_max_h = 0;
+	SIXEL_term_mouse_pixels = 0;
+	SIXEL_term_pixel_w = 0;
+	SIXEL_term_pixel_h = 0;
+
+	if ( ! SIXEL_CanProbe(this) ) {
+		return(0);
+	}
+
+	if ( SIXEL_ProfilePath(path, sizeof(path)) < 0 ||
+	     SIXEL_LoadProfile(this, path) < 0 ) {
+		SIXEL_probe_pending = 1;
+	} else {
+		SIXEL_ApplyProbe(this);
+	}
+
+	/* The window size is always asked for, the rest only without a
+	   profile, and DA1 ends either round trip
+	*/
+	SDL_mutexP(SIXEL_mutex);
+	SIXEL_WriteBytes(this, "\033[14t", 5);
+	if ( SIXEL_probe_pending ) {
+		SIXEL_WriteBytes(this, "\033[?1;1;0S\033[?2;1;0S\033[?1016$p", 26);
+	}
+	SIXEL_WriteBytes(this, "\033[c", 3);
+	SIXEL_FlushWriter(this);
+	SDL_mutexV(SIXEL_mutex);
+
+	SIXEL_AwaitProbe(this);
+	if ( SIXEL_probe_pending ) {
+		return(0);
+	}
+	if ( ! SIXEL_term_sixel ) {
+		SDL_SetError("The terminal doesn't support sixel graphics");
+		return(-1);
+	}
+	return(0);
+}
@@ -0,0 +1,44 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+
+
+#include "SDL_sixelvideo.h"
+
+/* Functions exported by SDL_sixelprobe.c to the rest of the sixel driver */
+
+/* The answers the probe asks for, as read by SDL_sixelinput.c */
+#define SIXEL_REPLY_DA1          (1 << 12 | ('?' - ';') << 4 << 6 | ('c' - '@'))
+#define SIXEL_REPLY_DECRPM       (1 << 12 | ('?' - ';') << 4 << 6 | ('$' - 0x1f) << 6 | ('y' - '@'))
+#define SIXEL_REPLY_XTSMGRAPHICS (1 << 12 | ('?' - ';') << 4 << 6 | ('S' - '@'))
+/* The window size reports asked for with CSI 14 t and CSI 18 t */
+#define SIXEL_DTTERM_SEQS        (1 << 12 | ('t' - '@'))
+
+/* Find out what the terminal can do, from its profile if there is one,
+   and the size of its window in pixels, which goes to SIXEL_term_pixel_w
+   and SIXEL_term_pixel_h.  Returns -1 if the terminal can't show sixel
+   graphics.
+*/
+extern int SIXEL_ProbeTerminal(_THIS);
+
+/* Take in an answer to the probe, returns 0 if the key is something else */
+extern int SIXEL_ProbeReply(_THIS, sixel_key_t *key);
+
@@ -0,0 +1,329 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+
+#include "SDL_config.h"
+
+/* Update rectangle processing for the sixel driver.
+
+   The screen is split into tiles matching the character cells of the
+   terminal, since that is the granularity the cursor can be positioned
+   at.  Every tile touched by an update is compared with a copy of the
+   last frame that went to the encoder, and only the tiles that really
+   changed are re-encoded, coalesced into as few rectangles as possible.
+
+   Every separate image has a fixed cost on top of its pixels, so what is
+   left is then merged further as long as it makes the whole update
+   cheaper, even if that means encoding a few unchanged pixels.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL.h"
+#include "SDL_sixelvideo.h"
+#include "SDL_sixelrects_c.h"
+
+void SIXEL_FreeDiff(_THIS)
+{
+	if ( SIXEL_shadow ) {
+		free(SIXEL_shadow);
+		SIXEL_shadow = NULL;
+	}
+	if ( SIXEL_tiles ) {
+		free(SIXEL_tiles);
+		SIXEL_tiles = NULL;
+	}
+	if ( SIXEL_tile_rects ) {
+		free(SIXEL_tile_rects);
+		SIXEL_tile_rects = NULL;
+	}
+	if ( SIXEL_tile_spans ) {
+		free(SIXEL_tile_spans);
+		SIXEL_tile_spans = NULL;
+	}
+	SIXEL_tile_w = 0;
+	SIXEL_tile_h = 0;
+}
+
+static int SIXEL_AllocDiff(_THIS, int tile_w, int tile_h)
+{
+	SIXEL_FreeDiff(this);
+
+	SIXEL_tile_cols = (SIXEL_w + tile_w - 1) / tile_w;
+	SIXEL_tile_rows = (SIXEL_h + tile_h - 1) / tile_h;
+	SIXEL_shadow = malloc(SIXEL_w * SIXEL_h * SIXEL_bpp);
+	SIXEL_tiles = malloc(SIXEL_tile_cols * SIXEL_tile_rows);
+	SIXEL_tile_rects = malloc(SIXEL_tile_cols * SIXEL_tile_rows * sizeof(SDL_Rect));
+	SIXEL_tile_spans = malloc(SIXEL_tile_cols * 2 * sizeof(int));
+	if ( ! SIXEL_shadow || ! SIXEL_tiles ||
+	     ! SIXEL_tile_rects || ! SIXEL_tile_spans ) {
+		SIXEL_FreeDiff(this);
+		return(-1);
+	}
+	SIXEL_tile_w = tile_w;
+	SIXEL_tile_h = tile_h;
+	/* Nothing has been sent with this geometry yet */
+	SIXEL_shadow_valid = 0;
+	return(0);
+}
+
+/* Compare a tile with the shadow frame, and update the shadow if needed */
+static int SIXEL_TileChanged(_THIS, int col, int row)
+{
+	int x, y, w, h;
+	int pitch = SIXEL_w * SIXEL_bpp;
+	unsigned char *src, *dst;
+
+	x = col * SIXEL_tile_w;
+	y = row * SIXEL_tile_h;
+	w = SDL_min(SIXEL_tile_w, SIXEL_w - x) * SIXEL_bpp;
+	h = SDL_min(SIXEL_tile_h, SIXEL_h - y);
+	src = SIXEL_buffer + y * pitch + x * SIXEL_bpp;
+	dst = SIXEL_shadow + y * pitch + x * SIXEL_bpp;
+
+	if ( SIXEL_shadow_valid ) {
+		while ( h > 0 && memcmp(dst, src, w) == 0 ) {
+			src += pitch;
+			dst += pitch;
+			--h;
+		}
+		if ( h == 0 ) {
+			return(0);
+		}
+	}
+	while ( h-- > 0 ) {
+		memcpy(dst, src, w);
+		src += pitch;
+		dst += pitch;
+	}
+	return(1);
+}
+
+int SIXEL_DiffRects(_THIS, int numrects, SDL_Rect *rects, SDL_Rect **result)
+{
+	int tile_w, tile_h;
+	int i, n, row, col, first, span;
+	int col1, row1, col2, row2;
+	int *prev, *next, *swap;
+	Uint8 *tiles;
+	SDL_Rect *rect, screen;
+
+	*result = rects;
+	tile_w = SIXEL_scale_cell_w;
+	tile_h = SIXEL_scale_cell_h;
+	if ( tile_w <= 0 || tile_h <= 0 ) {
+		return(numrects);
+	}
+	if ( tile_w != SIXEL_tile_w || tile_h != SIXEL_tile_h ) {
+		if ( SIXEL_AllocDiff(this, tile_w, tile_h) < 0 ) {
+			return(numrects);
+		}
+	}
+
+	/* What the terminal shows is unknown, so start with a full frame */
+	if ( ! SIXEL_shadow_valid ) {
+		screen.x = 0;
+		screen.y = 0;
+		screen.w = SIXEL_w;
+		screen.h = SIXEL_h;
+		numrects = 1;
+		rects = &screen;
+	}
+
+	/* Find the tiles that changed since the last frame */
+	memset(SIXEL_tiles, 0, SIXEL_tile_cols * SIXEL_tile_rows);
+	for ( i = 0; i < numrects; ++i ) {
+		rect = &rects[i];
+		col1 = rect->x / tile_w;
+		row1 = rect->y / tile_h;
+		col2 = SDL_min((rect->x + rect->w + tile_w - 1) / tile_w, SIXEL_tile_cols);
+		row2 = SDL_min((rect->y + rect->h + tile_h - 1) / tile_h, SIXEL_tile_rows);
+		for ( row = row1; row < row2; ++row ) {
+			tiles = SIXEL_tiles + row * SIXEL_tile_cols;
+			for ( col = col1; col < col2; ++col ) {
+				if ( ! tiles[col] && SIXEL_TileChanged(this, col, row) ) {
+					tiles[col] = 1;
+				}
+			}
+		}
+	}
+	SIXEL_shadow_valid = 1;
+
+	/* Coalesce runs of changed tiles into rectangles.  A run covering
+	   exactly the same columns as one on the previous tile row extends
+	   that rectangle downwards instead of starting a new one.
+	*/
+	n = 0;
+	prev = SIXEL_tile_spans;
+	next = SIXEL_tile_spans + SIXEL_tile_cols;
+	for ( col = 0; col < SIXEL_tile_cols; ++col ) {
+		prev[col] = -1;
+	}
+	for ( row = 0; row < SIXEL_tile_rows; ++row ) {
+		tiles = SIXEL_tiles + row * SIXEL_tile_cols;
+		for ( col = 0; col < SIXEL_tile_cols; ++col ) {
+			next[col] = -1;
+		}
+		col = 0;
+		while ( col < SIXEL_tile_cols ) {
+			if ( ! tiles[col] ) {
+				++col;
+				continue;
+			}
+			first = col;
+			while ( col < SIXEL_tile_cols && tiles[col] ) {
+				++col;
+			}
+			span = prev[first];
+			if ( span >= 0 &&
+			     SIXEL_tile_rects[span].x + SIXEL_tile_rects[span].w ==
+			     SDL_min(col * tile_w, SIXEL_w) ) {
+				rect = &SIXEL_tile_rects[span];
+				rect->h = SDL_min((row + 1) * tile_h, SIXEL_h) - rect->y;
+			} else {
+				span = n++;
+				rect = &SIXEL_tile_rects[span];
+				rect->x = first * tile_w;
+				rect->y = row * tile_h;
+				rect->w = SDL_min(col * tile_w, SIXEL_w) - rect->x;
+				rect->h = SDL_min(tile_h, SIXEL_h - rect->y);
+			}
+			next[first] = span;
+		}
+		swap = prev;
+		prev = next;
+		next = swap;
+	}
+	*result = SIXEL_tile_rects;
+	return(n);
+}
+
+void SIXEL_FreeCoalesce(_THIS)
+{
+	if ( SIXEL_merge_rects ) {
+		free(SIXEL_merge_rects);
+		SIXEL_merge_rects = NULL;
+	}
+	SIXEL_merge_size = 0;
+}
+
+int SIXEL_CoalesceRects(_THIS, int numrects, SDL_Rect *rects, SDL_Rect **result)
+{
+	int i, j, merged;
+	int x1, y1, x2, y2;
+	SDL_Rect *a, *b, *list;
+
+	*result = rects;
+	if ( numrects < 2 ) {
+		return(numrects);
+	}
+
+	/* Work on our own copy, the caller's rectangles are left alone */
+	if ( rects == SIXEL_tile_rects ) {
+		list = rects;
+	} else {
+		if ( numrects > SIXEL_merge_size ) {
+			list = realloc(SIXEL_merge_rects, numrects * sizeof(*rects));
+			if ( ! list ) {
+				return(numrects);
+			}
+			SIXEL_merge_rects = list;
+			SIXEL_merge_size = numrects;
+		}
+		list = SIXEL_merge_rects;
+		memcpy(list, rects, numrects * sizeof(*rects));
+	}
+
+	do {
+		merged = 0;
+		for ( i = 0; i < numrects; ++i ) {
+			a = &list[i];
+			for ( j = i + 1; j < numrects; ++j ) {
+				b = &list[j];
+				x1 = SDL_min(a->x, b->x);
+				y1 = SDL_min(a->y, b->y);
+				x2 = SDL_max(a->x + a->w, b->x + b->w);
+				y2 = SDL_max(a->y + a->h, b->y + b->h);
+				if ( (x2 - x1) * (y2 - y1) >
+				     a->w * a->h + b->w * b->h + SIXEL_RECT_OVERHEAD ) {
+					continue;
+				}
+				a->x = x1;
+				a->y = y1;
+				a->w = x2 - x1;
+				a->h = y2 - y1;
+				*b = list[--numrects];
+				merged = 1;
+				/* Rescan, the grown rectangle may now absorb others */
+				j = i;
+			}
+		}
+	} while ( merged );
+
+	*result = list;
+	return(numrects);
+}
+
+void SIXEL_AddRects(SDL_Rect *list, int *count, int numrects, SDL_Rect *rects)
+{
+	int i, x1, y1, x2, y2;
+	SDL_Rect *rect;
+
+	if ( *count + numrects <= SIXEL_MAXRECTS ) {
+		memcpy(list + *count, rects, numrects * sizeof(*rects));
+		*count += numrects;
+		return;
+	}
+
+	/* Too many rectangles, collapse everything into the bounding box */
+	if ( *count > 0 ) {
+		rect = &list[0];
+		x1 = rect->x;
+		y1 = rect->y;
+		x2 = rect->x + rect->w;
+		y2 = rect->y + rect->h;
+		for ( i = 1; i < *count; ++i ) {
+			rect = &list[i];
+			x1 = SDL_min(x1, rect->x);
+			y1 = SDL_min(y1, rect->y);
+			x2 = SDL_max(x2, rect->x + rect->w);
+			y2 = SDL_max(y2, rect->y + rect->h);
+		}
+	} else {
+		x1 = rects->x;
+		y1 = rects->y;
+		x2 = rects->x + rects->w;
+		y2 = rects->y + rects->h;
+	}
+	for ( i = 0; i < numrects; ++i ) {
+		rect = &rects[i];
+		x1 = SDL_min(x1, rect->x);
+		y1 = SDL_min(y1, rect->y);
+		x2 = SDL_max(x2, rect->x + rect->w);
+		y2 = SDL_max(y2, rect->y + rect->h);
+	}
+	list[0].x = x1;
+	list[0].y = y1;
+	list[0].w = x2 - x1;
+	list[0].h = y2 - y1;
+	*count = 1;
+}
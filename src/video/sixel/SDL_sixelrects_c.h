@@ -0,0 +1,45 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+
+
+#include "SDL_sixelvideo.h"
+
+/* Functions exported by SDL_sixelrects.c to the rest of the sixel driver */
+
+/* Reduce cell aligned update rectangles to the tiles that differ from the
+   last frame handed to the encoder.  Returns the number of rectangles
+   stored in *result, which stays valid until the next call.
+*/
+extern int SIXEL_DiffRects(_THIS, int numrects, SDL_Rect *rects, SDL_Rect **result);
+extern void SIXEL_FreeDiff(_THIS);
+
+/* Merge rectangles whenever encoding their union is cheaper than encoding
+   them separately, counting SIXEL_RECT_OVERHEAD extra pixels per image.
+   Returns the number of rectangles stored in *result.
+*/
+extern int SIXEL_CoalesceRects(_THIS, int numrects, SDL_Rect *rects, SDL_Rect **result);
+extern void SIXEL_FreeCoalesce(_THIS);
+
+/* Append rectangles to a list holding up to SIXEL_MAXRECTS of them,
+   collapsing the whole list into its bounding box when it overflows.
+*/
+extern void SIXEL_AddRects(SDL_Rect *list, int *count, int numrects, SDL_Rect *rects);
@@ -0,0 +1,321 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+
+#include "SDL_config.h"
+
+/* Output scaling for the sixel driver.
+
+   A picture larger than the terminal is of no use, and sending fewer
+   pixels is by far the cheapest way of going faster.  So a framebuffer
+   that doesn't fit the terminal, or the largest sixel image it takes, is
+   shrunk until it does, unless SDL_SIXEL_SCALE gives a fixed factor
+   instead, 1 turning scaling off.
+
+   Everything up to the encoder keeps working on the framebuffer, with
+   character cells covering more of its pixels.  As those are whole
+   numbers of pixels, update rectangles still map to whole cells on the
+   terminal, at the price of the horizontal and vertical factors differing
+   slightly when the cell size doesn't divide evenly.
+
+   When cells are a whole multiple of the terminal ones the pixels are
+   averaged over boxes, otherwise they are interpolated bilinearly, rows
+   being mixed with SSE2 when available.  Palette indices can't be mixed,
+   so 8-bit modes get the nearest pixel instead.  Only pixels inside the
+   rectangle being scaled are read, as the snapshots of the asynchronous
+   encoder hold nothing else.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL.h"
+#include "SDL_cpuinfo.h"
+#include "SDL_sixelvideo.h"
+#include "SDL_sixelscale_c.h"
+
+#if SDL_ASSEMBLY_ROUTINES && defined(__GNUC__) && defined(__SSE2__)
+#define SIXEL_SSE2 1
+#include <emmintrin.h>
+#endif
+
+void SIXEL_FreeScale(_THIS)
+{
+	if ( SIXEL_scale_buffer ) {
+		free(SIXEL_scale_buffer);
+		SIXEL_scale_buffer = NULL;
+	}
+	if ( SIXEL_scale_row ) {
+		free(SIXEL_scale_row);
+		SIXEL_scale_row = NULL;
+	}
+	if ( SIXEL_scale_cols ) {
+		free(SIXEL_scale_cols);
+		SIXEL_scale_cols = NULL;
+	}
+	SIXEL_scaled = 0;
+	SIXEL_scale_cell_w = 0;
+	SIXEL_scale_cell_h = 0;
+}
+
+void SIXEL_UpdateScale(_THIS)
+{
+	int term_w, term_h;
+	int cell_w, cell_h;
+	int scale_w, scale_h;
+	int area_w, area_h;
+
+	if ( SIXEL_cell_w == 0 || SIXEL_cell_h == 0 ) {
+		return;
+	}
+	term_w = SIXEL_pixel_w / SIXEL_cell_w;
+	term_h = SIXEL_pixel_h / SIXEL_cell_h;
+	if ( term_w <= 0 || term_h <= 0 ) {
+		return;
+	}
+
+	area_w = SIXEL_pixel_w;
+	area_h = SIXEL_pixel_h;
+	SIXEL_FitArea(this, &area_w, &area_h);
+
+	/* Round cells up to whole pixels, so the picture still fits */
+	if ( SIXEL_scale_factor > 0.0 ) {
+		cell_w = (int)(term_w * SIXEL_scale_factor - 0.001) + 1;
+		cell_h = (int)(term_h * SIXEL_scale_factor - 0.001) + 1;
+	} else if ( SIXEL_w * area_h >= SIXEL_h * area_w ) {
+		cell_w = (term_w * SIXEL_w + area_w - 1) / area_w;
+		cell_h = (term_h * SIXEL_w + area_w - 1) / area_w;
+	} else {
+		cell_w = (term_w * SIXEL_h + area_h - 1) / area_h;
+		cell_h = (term_h * SIXEL_h + area_h - 1) / area_h;
+	}
+	/* Small pictures are left alone */
+	cell_w = SDL_max(cell_w, term_w);
+	cell_h = SDL_max(cell_h, term_h);
+	scale_w = (SIXEL_w * term_w + cell_w - 1) / cell_w;
+	scale_h = (SIXEL_h * term_h + cell_h - 1) / cell_h;
+	if ( cell_w == SIXEL_scale_cell_w && cell_h == SIXEL_scale_cell_h &&
+	     scale_w == SIXEL_scale_w && scale_h == SIXEL_scale_h ) {
+		return;
+	}
+
+	/* The encoder may be busy with the old geometry */
+	SDL_mutexP(SIXEL_mutex);
+	SIXEL_FreeScale(this);
+	if ( cell_w != term_w || cell_h != term_h ) {
+		SIXEL_scale_buffer = malloc(scale_w * scale_h * SIXEL_bpp);
+		SIXEL_scale_row = malloc(SIXEL_w * SIXEL_bpp);
+		SIXEL_scale_cols = malloc(scale_w * sizeof(*SIXEL_scale_cols));
+		if ( SIXEL_scale_buffer && SIXEL_scale_row && SIXEL_scale_cols ) {
+			SIXEL_scaled = 1;
+		} else {
+			/* Better slow than nothing */
+			SIXEL_FreeScale(this);
+			cell_w = term_w;
+			cell_h = term_h;
+		}
+	}
+	SIXEL_scale_cell_w = cell_w;
+	SIXEL_scale_cell_h = cell_h;
+	SIXEL_scale_term_w = term_w;
+	SIXEL_scale_term_h = term_h;
+	SIXEL_scale_w = scale_w;
+	SIXEL_scale_h = scale_h;
+	/* Whatever the terminal shows has the wrong size */
+	SIXEL_shadow_valid = 0;
+	SDL_mutexV(SIXEL_mutex);
+}
+
+/* Framebuffer coordinate sampled for a pixel on the terminal, in 1/256ths
+   and kept between lo and hi - 1
+*/
+static int SIXEL_SourceCoord(int o, int cell, int term, int lo, int hi)
+{
+	int s = ((2 * o + 1) * cell - term) * 128 / term;
+
+	return SDL_max(lo << 8, SDL_min(s, (hi - 1) << 8));
+}
+
+static void SIXEL_ScaleNearest(_THIS, const Uint8 *pixels, int pitch, const SDL_Rect *rect, const SDL_Rect *out)
+{
+	int ox, oy, y;
+	int *cols = SIXEL_scale_cols;
+	const Uint8 *src;
+	Uint8 *dst;
+
+	for ( ox = out->x; ox < out->x + out->w; ++ox ) {
+		cols[ox] = ((SIXEL_SourceCoord(ox, SIXEL_scale_cell_w, SIXEL_scale_term_w,
+		                               rect->x, rect->x + rect->w) + 128) >> 8) - rect->x;
+	}
+	for ( oy = out->y; oy < out->y + out->h; ++oy ) {
+		y = (SIXEL_SourceCoord(oy, SIXEL_scale_cell_h, SIXEL_scale_term_h,
+		                       rect->y, rect->y + rect->h) + 128) >> 8;
+		src = pixels + (y - rect->y) * pitch;
+		dst = SIXEL_scale_buffer + oy * SIXEL_scale_w;
+		for ( ox = out->x; ox < out->x + out->w; ++ox ) {
+			dst[ox] = src[cols[ox]];
+		}
+	}
+}
+
+static void SIXEL_ScaleBox(_THIS, const Uint8 *pixels, int pitch, const SDL_Rect *rect, const SDL_Rect *out)
+{
+	int fx = SIXEL_scale_cell_w / SIXEL_scale_term_w;
+	int fy = SIXEL_scale_cell_h / SIXEL_scale_term_h;
+	int bpp = SIXEL_bpp;
+	int ox, oy, x, y, c, n;
+	int x1, x2, y1, y2;
+	Uint32 sum[4];
+	const Uint8 *src;
+	Uint8 *dst;
+
+	for ( oy = out->y; oy < out->y + out->h; ++oy ) {
+		y1 = SDL_max(oy * fy, rect->y);
+		y2 = SDL_min(oy * fy + fy, rect->y + rect->h);
+		dst = SIXEL_scale_buffer + (oy * SIXEL_scale_w + out->x) * bpp;
+		for ( ox = out->x; ox < out->x + out->w; ++ox ) {
+			x1 = SDL_max(ox * fx, rect->x);
+			x2 = SDL_min(ox * fx + fx, rect->x + rect->w);
+			sum[0] = sum[1] = sum[2] = sum[3] = 0;
+			for ( y = y1; y < y2; ++y ) {
+				src = pixels + (y - rect->y) * pitch + (x1 - rect->x) * bpp;
+				for ( x = x1; x < x2; ++x ) {
+					for ( c = 0; c < bpp; ++c ) {
+						sum[c] += *src++;
+					}
+				}
+			}
+			n = (x2 - x1) * (y2 - y1);
+			for ( c = 0; c < bpp; ++c ) {
+				*dst++ = (sum[c] + n / 2) / n;
+			}
+		}
+	}
+}
+
+/* Mix two rows of bytes, weight being that of the second one in 1/256ths */
+static void SIXEL_BlendRows(Uint8 *dst, const Uint8 *a, const Uint8 *b, int len, int weight)
+{
+	int i = 0;
+
+#if SIXEL_SSE2
+	if ( SDL_HasSSE2() ) {
+		__m128i zero = _mm_setzero_si128();
+		__m128i half = _mm_set1_epi16(128);
+		__m128i wa = _mm_set1_epi16(256 - weight);
+		__m128i wb = _mm_set1_epi16(weight);
+		__m128i va, vb, lo, hi;
+
+		/* Both products fit in 16 bits, since the weights add up to 256 */
+		for ( ; i + 16 <= len; i += 16 ) {
+			va = _mm_loadu_si128((const __m128i *)(a + i));
+			vb = _mm_loadu_si128((const __m128i *)(b + i));
+			lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), wa),
+			                   _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), wb));
+			hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), wa),
+			                   _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), wb));
+			lo = _mm_srli_epi16(_mm_add_epi16(lo, half), 8);
+			hi = _mm_srli_epi16(_mm_add_epi16(hi, half), 8);
+			_mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+		}
+	}
+#endif
+	for ( ; i < len; ++i ) {
+		dst[i] = (a[i] * (256 - weight) + b[i] * weight + 128) >> 8;
+	}
+}
+
+static void SIXEL_ScaleBilinear(_THIS, const Uint8 *pixels, int pitch, const SDL_Rect *rect, const SDL_Rect *out)
+{
+	int bpp = SIXEL_bpp;
+	int *cols = SIXEL_scale_cols;
+	int ox, oy, x, y, c, wx, wy;
+	const Uint8 *row, *p, *q;
+	Uint8 *dst;
+
+	/* Columns are relative to the rectangle, as rows get mixed into a
+	   buffer holding just that
+	*/
+	for ( ox = out->x; ox < out->x + out->w; ++ox ) {
+		cols[ox] = SIXEL_SourceCoord(ox, SIXEL_scale_cell_w, SIXEL_scale_term_w,
+		                             rect->x, rect->x + rect->w) - (rect->x << 8);
+	}
+	for ( oy = out->y; oy < out->y + out->h; ++oy ) {
+		y = SIXEL_SourceCoord(oy, SIXEL_scale_cell_h, SIXEL_scale_term_h,
+		                      rect->y, rect->y + rect->h);
+		wy = y & 0xff;
+		row = pixels + ((y >> 8) - rect->y) * pitch;
+		if ( wy ) {
+			SIXEL_BlendRows(SIXEL_scale_row, row, row + pitch, rect->w * bpp, wy);
+			row = SIXEL_scale_row;
+		}
+		dst = SIXEL_scale_buffer + (oy * SIXEL_scale_w + out->x) * bpp;
+		for ( ox = out->x; ox < out->x + out->w; ++ox ) {
+			x = cols[ox];
+			wx = x & 0xff;
+			p = row + (x >> 8) * bpp;
+			q = wx ? p + bpp : p;
+			for ( c = 0; c < bpp; ++c ) {
+				*dst++ = (p[c] * (256 - wx) + q[c] * wx + 128) >> 8;
+			}
+		}
+	}
+}
+
+void SIXEL_ScaleRect(_THIS, const Uint8 *pixels, int pitch, const SDL_Rect *rect, SDL_Rect *out)
+{
+	int x2, y2;
+	Uint64 start = SIXEL_GetMicroseconds();
+
+	out->x = rect->x * SIXEL_scale_term_w / SIXEL_scale_cell_w;
+	out->y = rect->y * SIXEL_scale_term_h / SIXEL_scale_cell_h;
+	x2 = ((rect->x + rect->w) * SIXEL_scale_term_w + SIXEL_scale_cell_w - 1) / SIXEL_scale_cell_w;
+	y2 = ((rect->y + rect->h) * SIXEL_scale_term_h + SIXEL_scale_cell_h - 1) / SIXEL_scale_cell_h;
+	out->w = SDL_min(x2, SIXEL_scale_w) - out->x;
+	out->h = SDL_min(y2, SIXEL_scale_h) - out->y;
+
+	if ( SIXEL_bpp == 1 ) {
+		SIXEL_ScaleNearest(this, pixels, pitch, rect, out);
+	} else if ( SIXEL_scale_cell_w % SIXEL_scale_term_w == 0 &&
+	            SIXEL_scale_cell_h % SIXEL_scale_term_h == 0 ) {
+		SIXEL_ScaleBox(this, pixels, pitch, rect, out);
+	} else {
+		SIXEL_ScaleBilinear(this, pixels, pitch, rect, out);
+	}
+	SIXEL_stats.scale_us += SIXEL_GetMicroseconds() - start;
+}
+
+void SIXEL_FitArea(_THIS, int *w, int *h)
+{
+	/* Fit the largest image the terminal takes, if that is smaller */
+	if ( SIXEL_term_max_w > 0 && SIXEL_term_max_h > 0 ) {
+		*w = SDL_min(*w, SIXEL_term_max_w);
+		*h = SDL_min(*h, SIXEL_term_max_h);
+	}
+}
+
+void SIXEL_ScalePoint(_THIS, int *x, int *y)
+{
+	if ( SIXEL_scaled ) {
+		*x = SDL_min(*x * SIXEL_scale_cell_w / SIXEL_scale_term_w, SIXEL_w - 1);
+		*y = SDL_min(*y * SIXEL_scale_cell_h / SIXEL_scale_term_h, SIXEL_h - 1);
+	}
+}
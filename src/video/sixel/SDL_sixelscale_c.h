@@ -0,0 +1,44 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+
+
+#include "SDL_sixelvideo.h"
+
+/* Functions exported by SDL_sixelscale.c to the rest of the sixel driver */
+
+/* Work out how many framebuffer pixels go into a character cell, from the
+   terminal geometry and SDL_SIXEL_SCALE.  Cheap when nothing changed.
+*/
+extern void SIXEL_UpdateScale(_THIS);
+extern void SIXEL_FreeScale(_THIS);
+
+/* Scale a rectangle of cells into SIXEL_scale_buffer, and return where it
+   ended up there.  pixels is the top left corner of the rectangle, with
+   rows pitch bytes apart.
+*/
+extern void SIXEL_ScaleRect(_THIS, const Uint8 *pixels, int pitch, const SDL_Rect *rect, SDL_Rect *out);
+
+/* Map a point on the terminal back to the framebuffer */
+extern void SIXEL_ScalePoint(_THIS, int *x, int *y);
+
+/* Shrink a size in terminal pixels to the largest image the terminal takes */
+extern void SIXEL_FitArea(_THIS, int *w, int *h);
@@ -0,0 +1,309 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+
+#include "SDL_config.h"
+
+/* Scroll detection for the sixel driver.
+
+   Every pixel row of the last frame sent is summed up by a hash.  When an
+   update spans at least two character rows, the hashes of the new rows are
+   compared with the old ones shifted by whole character rows, and the
+   longest band of character rows that moved as a block is scrolled by the
+   terminal itself.  The diff shadow is moved the same way, so only the
+   newly exposed rows and whatever else changed get encoded.
+
+   Scrolls are done either with a scroll region (DECSTBM and SU/SD), which
+   also moves any text beside the picture, or with a rectangular copy
+   (DECCRA).  Terminals differ in which of these also move sixel graphics,
+   hence SDL_SIXEL_SCROLL picks one, and neither is used by default.
+*/
+
+#include "SDL.h"
+#include "SDL_sixelvideo.h"
+#include "SDL_sixelscroll_c.h"
+#include "SDL_sixelwriter_c.h"
+
+/* FNV-1a over a row of pixels, a word at a time */
+static Uint32 SIXEL_HashRow(const Uint8 *src, int len)
+{
+	Uint32 hash = 2166136261u;
+	Uint32 word;
+
+	while ( len >= 4 ) {
+		memcpy(&word, src, 4);
+		hash = (hash ^ word) * 16777619u;
+		src += 4;
+		len -= 4;
+	}
+	while ( len-- > 0 ) {
+		hash = (hash ^ *src++) * 16777619u;
+	}
+	return(hash);
+}
+
+void SIXEL_FreeScroll(_THIS)
+{
+	if ( SIXEL_row_hashes ) {
+		free(SIXEL_row_hashes);
+		SIXEL_row_hashes = NULL;
+	}
+	SIXEL_hashes_valid = 0;
+	SIXEL_nscrolls = 0;
+}
+
+/* Whether character row r of the new frame matches row r + k of the old */
+static int SIXEL_RowMoved(_THIS, const Uint32 *old, const Uint32 *cur, int r, int k, int cell)
+{
+	int y;
+
+	for ( y = r * cell; y < (r + 1) * cell; ++y ) {
+		if ( cur[y] != old[y + k * cell] ) {
+			return(0);
+		}
+	}
+	return(1);
+}
+
+void SIXEL_DetectScroll(_THIS, int numrects, SDL_Rect *rects)
+{
+	int pitch = SIXEL_w * SIXEL_bpp;
+	int cell, rows, cols;
+	int y, y1, y2, r, r1, r2, k, run, moved;
+	int best_k, best_top, best_rows, best_moved;
+	int top, bottom, exposed;
+	Uint32 *old, *cur;
+	sixel_scroll_t scroll;
+	int i;
+
+	if ( ! SIXEL_scroll || ! SIXEL_shadow || ! SIXEL_shadow_valid ) {
+		SIXEL_hashes_valid = 0;
+		return;
+	}
+	cell = SIXEL_tile_h;
+	rows = SDL_min(SIXEL_h / cell, SIXEL_cell_h);
+	cols = SDL_min((SIXEL_w + SIXEL_tile_w - 1) / SIXEL_tile_w, SIXEL_cell_w);
+	if ( ! SIXEL_row_hashes ) {
+		SIXEL_row_hashes = malloc(2 * SIXEL_h * sizeof(*SIXEL_row_hashes));
+		if ( ! SIXEL_row_hashes ) {
+			return;
+		}
+	}
+	old = SIXEL_row_hashes;
+	cur = SIXEL_row_hashes + SIXEL_h;
+
+	/* The hashes follow the shadow, which is what the terminal shows */
+	if ( ! SIXEL_hashes_valid ) {
+		for ( y = 0; y < SIXEL_h; ++y ) {
+			old[y] = SIXEL_HashRow(SIXEL_shadow + y * pitch, pitch);
+		}
+		SIXEL_hashes_valid = 1;
+	}
+
+	/* Only the rows being updated can have changed.  A scroll moves whole
+	   rows, so it is only looked for within a full width update.
+	*/
+	y1 = SIXEL_h;
+	y2 = 0;
+	r1 = 0;
+	r2 = 0;
+	for ( i = 0; i < numrects; ++i ) {
+		y1 = SDL_min(y1, rects[i].y);
+		y2 = SDL_max(y2, rects[i].y + rects[i].h);
+		if ( rects[i].x == 0 && rects[i].w == SIXEL_w &&
+		     rects[i].h > (r2 - r1) * cell ) {
+			r1 = (rects[i].y + cell - 1) / cell;
+			r2 = SDL_min((rects[i].y + rects[i].h) / cell, rows);
+		}
+	}
+	if ( y1 >= y2 ) {
+		return;
+	}
+	memcpy(cur, old, SIXEL_h * sizeof(*cur));
+	for ( y = y1; y < y2; ++y ) {
+		cur[y] = SIXEL_HashRow(SIXEL_buffer + y * pitch, pitch);
+	}
+
+	/* Try every offset in whole character rows, both ways, and keep the
+	   longest band of rows that moved, counting only those that changed
+	*/
+	best_k = 0;
+	best_top = 0;
+	best_rows = 0;
+	best_moved = 0;
+	for ( k = -(r2 - r1 - 1); k < r2 - r1; ++k ) {
+		if ( k == 0 ) {
+			continue;
+		}
+		run = 0;
+		moved = 0;
+		for ( r = r1; r <= r2; ++r ) {
+			if ( r < r2 && r + k >= r1 && r + k < r2 &&
+			     SIXEL_RowMoved(this, old, cur, r, k, cell) ) {
+				++run;
+				if ( ! SIXEL_RowMoved(this, old, cur, r, 0, cell) ) {
+					++moved;
+				}
+				continue;
+			}
+			if ( run >= 2 && moved > best_moved ) {
+				best_k = k;
+				best_top = r - run;
+				best_rows = run;
+				best_moved = moved;
+			}
+			run = 0;
+			moved = 0;
+		}
+	}
+
+	memcpy(old, cur, SIXEL_h * sizeof(*old));
+	if ( best_moved < 1 ) {
+		return;
+	}
+
+	/* The terminal moves rows top to bottom - 1 by k, leaving k rows
+	   exposed at the end they move away from
+	*/
+	k = best_k;
+	scroll.left = 0;
+	scroll.right = cols;
+	if ( k > 0 ) {
+		scroll.top = best_top;
+		scroll.bottom = best_top + best_rows + k;
+	} else {
+		scroll.top = best_top + k;
+		scroll.bottom = best_top + best_rows;
+	}
+	scroll.lines = k;
+	if ( SIXEL_AddScrolls(this, SIXEL_scrolls, &SIXEL_nscrolls, 1, &scroll) < 0 ) {
+		return;
+	}
+	++SIXEL_stats.scrolls;
+
+	top = best_top * cell;
+	bottom = (best_top + best_rows) * cell;
+	memmove(SIXEL_shadow + top * pitch, SIXEL_shadow + (top + k * cell) * pitch,
+	        (bottom - top) * pitch);
+
+	/* A scroll region blanks the exposed rows, make sure they are sent */
+	if ( SIXEL_scroll == SIXEL_SCROLL_REGION ) {
+		if ( k > 0 ) {
+			exposed = bottom;
+		} else {
+			exposed = (best_top + k) * cell;
+		}
+		for ( y = 0; y < SDL_abs(k) * cell; ++y ) {
+			Uint8 *dst = SIXEL_shadow + (exposed + y) * pitch;
+			const Uint8 *src = SIXEL_buffer + (exposed + y) * pitch;
+
+			for ( i = 0; i < pitch; ++i ) {
+				dst[i] = ~src[i];
+			}
+		}
+	}
+}
+
+void SIXEL_EmitScrolls(_THIS, int nscrolls, sixel_scroll_t *scrolls)
+{
+	sixel_scroll_t *scroll;
+	char seq[64];
+	int i, len, lines;
+
+	for ( i = 0; i < nscrolls; ++i ) {
+		scroll = &scrolls[i];
+		lines = SDL_abs(scroll->lines);
+		if ( SIXEL_scroll == SIXEL_SCROLL_REGION ) {
+			/* Scroll region, scroll up or down, full screen region */
+			len = SDL_snprintf(seq, sizeof(seq), "\033[%d;%dr\033[%d%c\033[r",
+			                   scroll->top + 1, scroll->bottom, lines,
+			                   scroll->lines > 0 ? 'S' : 'T');
+		} else if ( scroll->lines > 0 ) {
+			/* Copy the rows below up */
+			len = SDL_snprintf(seq, sizeof(seq), "\033[%d;%d;%d;%d;1;%d;%d;1$v",
+			                   scroll->top + lines + 1, scroll->left + 1,
+			                   scroll->bottom, scroll->right,
+			                   scroll->top + 1, scroll->left + 1);
+		} else {
+			/* Copy the rows above down */
+			len = SDL_snprintf(seq, sizeof(seq), "\033[%d;%d;%d;%d;1;%d;%d;1$v",
+			                   scroll->top + 1, scroll->left + 1,
+			                   scroll->bottom - lines, scroll->right,
+			                   scroll->top + lines + 1, scroll->left + 1);
+		}
+		SIXEL_WriteBytes(this, seq, len);
+	}
+}
+
+void SIXEL_ScrollRects(_THIS, int nscrolls, sixel_scroll_t *scrolls, int numrects, SDL_Rect *rects)
+{
+	sixel_scroll_t *scroll;
+	SDL_Rect *rect;
+	int i, j, top, bottom, y1, y2, shift;
+
+	for ( i = 0; i < nscrolls; ++i ) {
+		scroll = &scrolls[i];
+		top = scroll->top * SIXEL_tile_h;
+		bottom = scroll->bottom * SIXEL_tile_h;
+		shift = scroll->lines * SIXEL_tile_h;
+		for ( j = 0; j < numrects; ++j ) {
+			rect = &rects[j];
+			y1 = SDL_max(rect->y, top);
+			y2 = SDL_min(rect->y + rect->h, bottom);
+			if ( y1 >= y2 ) {
+				continue;
+			}
+			y1 = SDL_max(y1 - shift, top);
+			y2 = SDL_min(y2 - shift, bottom);
+			if ( y1 >= y2 ) {
+				continue;
+			}
+			y1 = SDL_min(y1, rect->y);
+			y2 = SDL_max(y2, rect->y + rect->h);
+			rect->y = y1;
+			rect->h = y2 - y1;
+		}
+	}
+}
+
+int SIXEL_AddScrolls(_THIS, sixel_scroll_t *list, int *count, int nscrolls, sixel_scroll_t *scrolls)
+{
+	sixel_scroll_t *last;
+	int i;
+
+	for ( i = 0; i < nscrolls; ++i ) {
+		/* Scrolling a region twice the same way is one longer scroll,
+		   copies leave different rows behind and are kept apart
+		*/
+		last = (*count > 0) ? &list[*count - 1] : NULL;
+		if ( last && SIXEL_scroll == SIXEL_SCROLL_REGION &&
+		     last->top == scrolls[i].top && last->bottom == scrolls[i].bottom &&
+		     (last->lines > 0) == (scrolls[i].lines > 0) ) {
+			last->lines += scrolls[i].lines;
+			continue;
+		}
+		if ( *count == SIXEL_MAXSCROLLS ) {
+			return(-1);
+		}
+		list[(*count)++] = scrolls[i];
+	}
+	return(0);
+}
@@ -0,0 +1,47 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+
+
+#include "SDL_sixelvideo.h"
+
+/* Functions exported by SDL_sixelscroll.c to the rest of the sixel driver */
+
+/* Look for a vertical scroll between the last frame and the framebuffer
+   within the given update rectangles.  When one is found the diff shadow is
+   moved to match what the terminal will show once the scroll is carried out,
+   and the scroll is appended to SIXEL_scrolls.  Call before SIXEL_DiffRects.
+*/
+extern void SIXEL_DetectScroll(_THIS, int numrects, SDL_Rect *rects);
+extern void SIXEL_FreeScroll(_THIS);
+
+/* Queue the terminal side copies for a list of scrolls */
+extern void SIXEL_EmitScrolls(_THIS, int nscrolls, sixel_scroll_t *scrolls);
+
+/* Grow rectangles of cells not shown yet to also cover where the scrolls
+   move them to
+*/
+extern void SIXEL_ScrollRects(_THIS, int nscrolls, sixel_scroll_t *scrolls, int numrects, SDL_Rect *rects);
+
+/* Append scrolls to a list holding up to SIXEL_MAXSCROLLS of them, merging
+   those that add up.  Returns -1 if they don't fit.
+*/
+extern int SIXEL_AddScrolls(_THIS, sixel_scroll_t *list, int *count, int nscrolls, sixel_scroll_t *scrolls);
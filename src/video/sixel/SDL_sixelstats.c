@@ -0,0 +1,154 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+
+#include "SDL_config.h"
+
+/* Per-stage counters of the sixel driver, and their periodic dump */
+
+#include "SDL.h"
+#include "SDL_sixel.h"
+#include "SDL_sixelvideo.h"
+#include "SDL_sixelstats_c.h"
+
+/* How often SDL_SIXEL_STATS gets a new line */
+#define SIXEL_STATS_INTERVAL	1000000
+
+void SIXEL_InitStats(_THIS)
+{
+	const char *envr;
+
+	SIXEL_ClearStats(this);
+
+	SIXEL_stats_file = NULL;
+	envr = SDL_getenv("SDL_SIXEL_STATS");
+	if ( envr && *envr ) {
+		if ( SDL_strcmp(envr, "stderr") == 0 ) {
+			SIXEL_stats_file = stderr;
+		} else {
+			SIXEL_stats_file = fopen(envr, "w");
+		}
+	}
+}
+
+void SIXEL_QuitStats(_THIS)
+{
+	if ( SIXEL_stats_file && SIXEL_stats_file != stderr ) {
+		fclose(SIXEL_stats_file);
+	}
+	SIXEL_stats_file = NULL;
+}
+
+void SIXEL_ClearStats(_THIS)
+{
+	SDL_memset(&SIXEL_stats, 0, sizeof(SIXEL_stats));
+	SDL_memset(&SIXEL_stats_dumped, 0, sizeof(SIXEL_stats_dumped));
+	SIXEL_stats_mark = 0;
+	SIXEL_stats_time = SIXEL_GetMicroseconds();
+}
+
+static double SIXEL_PerFrame(Uint64 now, Uint64 then, Uint32 frames)
+{
+	return (double)(now - then) / 1000.0 / frames;
+}
+
+/* Write the averages since the last dump, in milliseconds per frame */
+static void SIXEL_DumpStats(_THIS)
+{
+	SDL_SixelStats *now = &SIXEL_stats;
+	SDL_SixelStats *then = &SIXEL_stats_dumped;
+	Uint32 frames = now->frames - then->frames;
+
+	if ( frames == 0 ) {
+		return;
+	}
+	fprintf(SIXEL_stats_file,
+	        "sixel: %u frames, %u dropped, %u fps, %u bytes/frame, "
+	        "copy %.2f, scale %.2f, diff %.2f, quantize %.2f, encode %.2f, write %.2f ms/frame, "
+	        "latency %.1f ms (max %.1f), %u bytes pending\n",
+	        frames, now->frames_dropped - then->frames_dropped,
+	        now->effective_fps, (Uint32)((now->bytes - then->bytes) / frames),
+	        SIXEL_PerFrame(now->copy_us, then->copy_us, frames),
+	        SIXEL_PerFrame(now->scale_us, then->scale_us, frames),
+	        SIXEL_PerFrame(now->diff_us, then->diff_us, frames),
+	        SIXEL_PerFrame(now->quantize_us, then->quantize_us, frames),
+	        SIXEL_PerFrame(now->encode_us, then->encode_us, frames),
+	        SIXEL_PerFrame(now->write_us, then->write_us, frames),
+	        now->latency_us / 1000.0, now->latency_max_us / 1000.0,
+	        SIXEL_out_pending.len - SIXEL_out_offset);
+	fflush(SIXEL_stats_file);
+	*then = *now;
+}
+
+void SIXEL_StatsFrame(_THIS, int numrects, Uint64 start)
+{
+	Uint64 now = SIXEL_GetMicroseconds();
+
+	++SIXEL_stats.frames;
+	SIXEL_stats.rects += numrects;
+	SIXEL_stats.encode_us += now - start;
+
+	/* Latency runs until the writer has nothing left */
+	if ( SIXEL_stats_mark == 0 ) {
+		SIXEL_stats_mark = now;
+	}
+
+	if ( SIXEL_stats_file && now - SIXEL_stats_time >= SIXEL_STATS_INTERVAL ) {
+		SIXEL_DumpStats(this);
+		SIXEL_stats_time = now;
+	}
+}
+
+static SDL_VideoDevice *SIXEL_GetDevice(void)
+{
+	if ( current_video == NULL || current_video->hidden == NULL ||
+	     SDL_strcmp(current_video->name, "sixel") != 0 ) {
+		SDL_SetError("Sixel video driver is not in use");
+		return NULL;
+	}
+	return current_video;
+}
+
+int SDL_SixelGetStats(SDL_SixelStats *stats)
+{
+	SDL_VideoDevice *this = SIXEL_GetDevice();
+
+	if ( this == NULL ) {
+		return(-1);
+	}
+	SDL_mutexP(SIXEL_mutex);
+	*stats = SIXEL_stats;
+	stats->pending = SIXEL_out_pending.len - SIXEL_out_offset;
+	SDL_mutexV(SIXEL_mutex);
+	return(0);
+}
+
+void SDL_SixelResetStats(void)
+{
+	SDL_VideoDevice *this = SIXEL_GetDevice();
+
+	if ( this == NULL ) {
+		return;
+	}
+	SDL_mutexP(SIXEL_mutex);
+	SIXEL_ClearStats(this);
+	SDL_mutexV(SIXEL_mutex);
+}
@@ -42,6 +42,19 @@
 
 #include "SDL_sixelvideo.h"
 #include "SDL_sixelevents_c.h"
+#include "SDL_sixelasync_c.h"
+#include "SDL_sixelrects_c.h"
+#include "SDL_sixelencode_c.h"
+#include "SDL_sixelwriter_c.h"
+#include "SDL_sixelpacing_c.h"
+#include "SDL_sixelstats_c.h"
+#include "SDL_sixelscroll_c.h"
+#include "SDL_sixelscale_c.h"
+#include "SDL_sixelcapture_c.h"
+#include "SDL_sixelinput_c.h"
+#include "SDL_sixelprobe_c.h"
+#include "SDL_sixelyuv_c.h"
+#include "SDL_sixelmouse_c.h"
 
 #include <sixel.h>
 #include <termios.h>
@@ -50,6 +63,7 @@
 /* Initialization/Query functions */
 static int SIXEL_VideoInit(_THIS, SDL_PixelFormat *vformat);
 static SDL_Rect **SIXEL_ListModes(_THIS, SDL_PixelFormat *format, Uint32 flags);
+static int SIXEL_SetColors(_THIS, int firstcolor, int ncolors, SDL_Color *colors);
 static SDL_Surface *SIXEL_SetVideoMode(_THIS, SDL_Surface *current, int width, int height, int bpp, Uint32 flags);
 static void SIXEL_VideoQuit(_THIS);
 #if SDL_VIDEO_OPENGL_OSMESA
@@ -124,17 +138,21 @@ void SIXEL_UpdateMouse(_THIS)
 static SDL_VideoDevice *SIXEL_CreateDevice(int devindex)
 {
 	SDL_VideoDevice *device;
-
-	tty_raw();
-	printf("\033c");
-	printf("\033[?25l");
-	printf("\033[?1003h");
-	printf("\033[?1006h");
-	printf("\033[>2p");
+	int headless = (SIXEL_OutputFile() != NULL);
+
+	/* Without a terminal there is nothing to set up */
+	if ( ! headless ) {
+		tty_raw();
+		printf("\033c");
+		printf("\033[?25l");
+		printf("\033[?1003h");
+		printf("\033[?1006h");
+		printf("\033[>2p");
 #if 1
-	printf("\033[1;1'z\033[3'{\033[1'{");
-	printf("\033['|");
+		printf("\033[1;1'z\033[3'{\033[1'{");
+		printf("\033['|");
 #endif
+	}
 
 	/* Initialize all variables that we clean on shutdown */
 	device = (SDL_VideoDevice *)malloc(sizeof(SDL_VideoDevice));
@@ -151,13 +169,16 @@ static SDL_VideoDevice *SIXEL_CreateDevice(int devindex)
 		return(0);
 	}
 	memset(device->hidden, 0, (sizeof *device->hidden));
+	device->hidden->headless = headless;
+	device->hidden->input_wake[0] = -1;
+	device->hidden->input_wake[1] = -1;
 
 	/* Set the function pointers */
 	device->VideoInit = SIXEL_VideoInit;
 	device->ListModes = SIXEL_ListModes;
 	device->SetVideoMode = SIXEL_SetVideoMode;
-	device->CreateYUVOverlay = NULL;
-	device->SetColors = NULL;
+	device->CreateYUVOverlay = SIXEL_CreateYUVOverlay;
+	device->SetColors = SIXEL_SetColors;
 	device->UpdateRects = NULL;
 	device->VideoQuit = SIXEL_VideoQuit;
 #if SDL_VIDEO_OPENGL_OSMESA
@@ -182,6 +203,10 @@ static SDL_VideoDevice *SIXEL_CreateDevice(int devindex)
 	device->IconifyWindow = NULL;
 	device->GrabInput = NULL;
 	device->GetWMInfo = NULL;
+	device->FreeWMCursor = SIXEL_FreeWMCursor;
+	device->CreateWMCursor = SIXEL_CreateWMCursor;
+	device->ShowWMCursor = SIXEL_ShowWMCursor;
+	device->MoveWMCursor = SIXEL_MoveWMCursor;
 	device->UpdateMouse = SIXEL_UpdateMouse;
 	device->InitOSKeymap = SIXEL_InitOSKeymap;
 	device->PumpEvents = SIXEL_PumpEvents;
@@ -195,38 +220,198 @@ VideoBootStrap SIXEL_bootstrap = {
 	SIXEL_Available, SIXEL_CreateDevice
 };
 
+Uint64 SIXEL_GetMicroseconds(void)
+{
+#if HAVE_CLOCK_GETTIME
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (Uint64)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+#else
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	return (Uint64)now.tv_sec * 1000000 + now.tv_usec;
+#endif
+}
+
 static int sixel_write(char *data, int size, void *priv)
 {
-	return fwrite(data, 1, size, (FILE *)priv);
+	SIXEL_WriteBytes((SDL_VideoDevice *)priv, data, size);
+	return size;
 }
 
-int SIXEL_VideoInit(_THIS, SDL_PixelFormat *vformat)
+/* Offer the modes named by SDL_SIXEL_MODES ("640x480,320x240"), or else
+   the size of the terminal window and whole fractions of it, so pictures
+   are sent at the size they are shown.  Modes are sorted largest to
+   smallest, and replace those offered before.
+*/
+int SIXEL_BuildModes(_THIS)
 {
-	int i;
+	static const int default_modes[SDL_NUMMODES][2] = {
+		{ 1024, 768 }, { 800, 600 }, { 640, 480 },
+		{ 320, 400 }, { 320, 240 }, { 320, 200 }
+	};
+	int modes[SDL_NUMMODES][2];
+	int i, j, n = 0;
+	int w, h;
+	const char *envr;
+	char *end;
+
+	envr = SDL_getenv("SDL_SIXEL_MODES");
+	while ( envr && *envr && n < SDL_NUMMODES ) {
+		w = SDL_strtol(envr, &end, 10);
+		if ( *end != 'x' ) {
+			break;
+		}
+		h = SDL_strtol(end + 1, &end, 10);
+		if ( w > 0 && h > 0 ) {
+			/* Keep them sorted */
+			for ( i = n; i > 0 && modes[i-1][0] * modes[i-1][1] < w * h; --i ) {
+				modes[i][0] = modes[i-1][0];
+				modes[i][1] = modes[i-1][1];
+			}
+			modes[i][0] = w;
+			modes[i][1] = h;
+			++n;
+		}
+		envr = (*end == ',') ? end + 1 : NULL;
+	}
+	if ( n == 0 && SIXEL_term_pixel_w > 0 && SIXEL_term_pixel_h > 0 ) {
+		w = SIXEL_term_pixel_w;
+		h = SIXEL_term_pixel_h;
+		SIXEL_FitArea(this, &w, &h);
+		/* Down to what is still of some use */
+		for ( i = 1; n < SDL_NUMMODES && w / i >= 160 && h / i >= 100; ++i ) {
+			modes[n][0] = w / i;
+			modes[n][1] = h / i;
+			++n;
+		}
+	}
+	if ( n == 0 ) {
+		SDL_memcpy(modes, default_modes, sizeof(modes));
+		n = SDL_NUMMODES;
+	}
 
-	/* Initialize all variables that we clean on shutdown */
-	for ( i=0; i<SDL_NUMMODES; ++i ) {
-		SDL_modelist[i] = malloc(sizeof(SDL_Rect));
-		SDL_modelist[i]->x = SDL_modelist[i]->y = 0;
-	}
-	/* Modes sorted largest to smallest */
-	SDL_modelist[0]->w = 1024; SDL_modelist[0]->h = 768;
-	SDL_modelist[1]->w = 800; SDL_modelist[1]->h = 600;
-	SDL_modelist[2]->w = 640; SDL_modelist[2]->h = 480;
-	SDL_modelist[3]->w = 320; SDL_modelist[3]->h = 400;
-	SDL_modelist[4]->w = 320; SDL_modelist[4]->h = 240;
-	SDL_modelist[5]->w = 320; SDL_modelist[5]->h = 200;
-	SDL_modelist[6] = NULL;
+	for ( j = 0; SDL_modelist[j]; ++j ) {
+		free(SDL_modelist[j]);
+		SDL_modelist[j] = NULL;
+	}
+	for ( j = 0; j < n; ++j ) {
+		SDL_modelist[j] = malloc(sizeof(SDL_Rect));
+		if ( ! SDL_modelist[j] ) {
+			SDL_OutOfMemory();
+			return(-1);
+		}
+		SDL_modelist[j]->x = SDL_modelist[j]->y = 0;
+		SDL_modelist[j]->w = modes[j][0];
+		SDL_modelist[j]->h = modes[j][1];
+	}
+	SDL_modelist[n] = NULL;
+	return(0);
+}
+
+int SIXEL_VideoInit(_THIS, SDL_PixelFormat *vformat)
+{
+	const char *envr;
 
 #if SDL_VIDEO_OPENGL_OSMESA
 	this->gl_config.driver_loaded = 1;
 #endif
 	SIXEL_mutex = SDL_CreateMutex();
+	if ( SIXEL_OpenWriter(this) < 0 ) {
+		return(-1);
+	}
+	if ( ! SIXEL_headless && SIXEL_StartInput(this) < 0 ) {
+		return(-1);
+	}
+
+	/* Find out what the terminal can do, and how large it is */
+	if ( SIXEL_ProbeTerminal(this) < 0 ) {
+		return(-1);
+	}
+
+	/* Offer modes the size of the terminal, and follow its changes */
+	if ( SIXEL_BuildModes(this) < 0 ) {
+		return(-1);
+	}
+	SIXEL_WatchResize(this);
+
+	/* Encode in a separate thread if requested */
+	envr = SDL_getenv("SDL_SIXEL_ASYNC");
+	if ( envr && SDL_atoi(envr) ) {
+		SIXEL_mailbox_lock = SDL_CreateMutex();
+		SIXEL_mailbox_cond = SDL_CreateCond();
+		SIXEL_async = 1;
+	}
+
+	/* Pick the encoder, see SIXEL_SetVideoMode */
+	envr = SDL_getenv("SDL_SIXEL_ENCODER");
+	SIXEL_builtin = (envr && SDL_strcmp(envr, "builtin") == 0);
+
+	/* Build the palette from the picture instead of using xterm's,
+	   which needs all 256 color registers */
+	envr = SDL_getenv("SDL_SIXEL_PALETTE");
+	if ( envr ) {
+		SIXEL_adaptive = (SDL_strcmp(envr, "adaptive") == 0);
+	} else {
+		SIXEL_adaptive = (SIXEL_term_colors < 256);
+	}
+	envr = SDL_getenv("SDL_SIXEL_PALETTE_DRIFT");
+	SIXEL_palette_drift = envr ? SDL_atoi(envr) : 20;
+
+	/* Split tall images between several encoding threads */
+	envr = SDL_getenv("SDL_SIXEL_THREADS");
+	if ( envr && SDL_strcmp(envr, "auto") == 0 ) {
+		SIXEL_nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	} else if ( envr ) {
+		SIXEL_nthreads = SDL_atoi(envr);
+	}
+	if ( SIXEL_nthreads < 1 ) {
+		SIXEL_nthreads = 1;
+	}
+
+	/* Pace frames to a target rate if requested */
+	envr = SDL_getenv("SDL_SIXEL_FPS");
+	SIXEL_InitPacing(this, envr ? SDL_atoi(envr) : 0);
+
+	/* Count what every stage costs, and maybe report it */
+	SIXEL_InitStats(this);
+
+	/* Record updates for test/testsixelreplay */
+	SIXEL_OpenCapture(this);
+
+	/* Only send the cells that changed, unless told otherwise */
+	envr = SDL_getenv("SDL_SIXEL_DIFF");
+	SIXEL_diff = envr ? SDL_atoi(envr) : 1;
+
+	/* Shrink pictures to fit the terminal, or by a given factor */
+	envr = SDL_getenv("SDL_SIXEL_SCALE");
+	if ( envr && SDL_strcmp(envr, "fit") != 0 ) {
+		SIXEL_scale_factor = SDL_max(SDL_atof(envr), 1.0);
+	}
+
+	/* Leave the pointer to the terminal instead of drawing SDL's */
+	envr = SDL_getenv("SDL_SIXEL_CURSOR");
+	SIXEL_cursor_terminal = (envr && SDL_strcmp(envr, "terminal") == 0);
+
+	/* Let the terminal scroll the picture, where it is known to work */
+	envr = SDL_getenv("SDL_SIXEL_SCROLL");
+	if ( envr && SDL_strcmp(envr, "region") == 0 ) {
+		SIXEL_scroll = SIXEL_SCROLL_REGION;
+	} else if ( envr && SDL_strcmp(envr, "deccra") == 0 ) {
+		SIXEL_scroll = SIXEL_SCROLL_DECCRA;
+	}
+
+#if SDL_VIDEO_OPENGL_OSMESA
+	/* Only update the scissor box on OpenGL buffer swaps */
+	envr = SDL_getenv("SDL_SIXEL_GL_SCISSOR");
+	SIXEL_glscissor = (envr && SDL_atoi(envr));
+#endif
 
 	/* Initialize the library */
 
 	/* Initialize private variables */
-	SIXEL_bitmap = NULL;
 	SIXEL_buffer = NULL;
 
 	local_this = this;
@@ -234,11 +419,11 @@ int SIXEL_VideoInit(_THIS, SDL_PixelFormat *vformat)
 	/* Determine the screen depth (use default 8-bit depth) */
 	vformat->BitsPerPixel = 24;
 	vformat->BytesPerPixel = 3;
-	SIXEL_output = sixel_output_create(sixel_write, stdout);
+	SIXEL_output = sixel_output_create(sixel_write, this);
 	SIXEL_dither = sixel_dither_get(BUILTIN_XTERM256);
-#if 0
-	sixel_dither_set_diffusion_type(SIXEL_dither, DIFFUSE_FS);
-#endif
+	/* Cells are sent again on their own, so every pixel must map to the
+	   same color whatever surrounds it */
+	sixel_dither_set_diffusion_type(SIXEL_dither, DIFFUSE_NONE);
 
 	/* We're done! */
 	return(0);
@@ -246,7 +431,8 @@ int SIXEL_VideoInit(_THIS, SDL_PixelFormat *vformat)
 
 SDL_Rect **SIXEL_ListModes(_THIS, SDL_PixelFormat *format, Uint32 flags)
 {
-	if(format->BitsPerPixel != 24)
+	if(format->BitsPerPixel != 24 && format->BitsPerPixel != 32 &&
+	   format->BitsPerPixel != 8)
 		return NULL;
 
 	 if ( flags & SDL_FULLSCREEN ) {
@@ -259,10 +445,23 @@ SDL_Rect **SIXEL_ListModes(_THIS, SDL_PixelFormat *format, Uint32 flags)
 SDL_Surface *SIXEL_SetVideoMode(_THIS, SDL_Surface *current,
 				int width, int height, int bpp, Uint32 flags)
 {
+	if ( SIXEL_async ) {
+		SIXEL_StopEncoder(this);
+	}
+	SIXEL_FreeDiff(this);
+	SIXEL_FreeScroll(this);
+	SIXEL_FreeScale(this);
+	SIXEL_FreeCursor(this);
 	if ( SIXEL_buffer ) {
 		free( SIXEL_buffer );
 		SIXEL_buffer = NULL;
 	}
+#if SDL_VIDEO_OPENGL_OSMESA
+	if ( SIXEL_glbuffer ) {
+		free( SIXEL_glbuffer );
+		SIXEL_glbuffer = NULL;
+	}
+#endif
 	SDL_PrivateAppActive(1, SDL_APPINPUTFOCUS | SDL_APPMOUSEFOCUS);
 
 	SIXEL_buffer = calloc(1, 4 * width * height);
@@ -270,45 +469,104 @@ SDL_Surface *SIXEL_SetVideoMode(_THIS, SDL_Surface *current,
 		SDL_SetError("Couldn't allocate buffer for requested mode");
 		return(NULL);
 	}
-	SIXEL_bitmap = calloc(1, 4 * width * height);
-	if ( ! SIXEL_bitmap ) {
-		SDL_SetError("Couldn't allocate buffer for requested mode");
+
+	/* 8-bit modes hand their palette indices straight to the encoder,
+	   32-bit ones their XRGB pixels.  OpenGL renders 24-bit RGB.
+	*/
+	if ( flags & SDL_OPENGL ) {
+		SIXEL_bpp = 3;
+	} else if ( bpp == 8 ) {
+		SIXEL_bpp = 1;
+	} else if ( bpp == 32 ) {
+		SIXEL_bpp = 4;
+	} else {
+		SIXEL_bpp = 3;
+	}
+	if ( SIXEL_InitEncoder(this, width) < 0 ) {
 		return(NULL);
 	}
+	SIXEL_ClearStats(this);
+
+	/* One encoder for the whole mode, two quantizing differently would
+	   show seams where their rectangles meet.  libsixel only takes RGB.
+	*/
+	SIXEL_libsixel = (! SIXEL_builtin && SIXEL_bpp == 3);
 
 	/* Allocate the new pixel format for the screen */
-	if (!SDL_ReallocFormat(current, 24, 0x0000ff, 0x00ff00, 0xff0000, 0)) {
-		return(NULL);
+	if ( SIXEL_bpp == 1 ) {
+		if (!SDL_ReallocFormat(current, 8, 0, 0, 0, 0)) {
+			return(NULL);
+		}
+	} else if ( SIXEL_bpp == 4 ) {
+		if (!SDL_ReallocFormat(current, 32, 0xff0000, 0x00ff00, 0x0000ff, 0)) {
+			return(NULL);
+		}
+	} else {
+		if (!SDL_ReallocFormat(current, 24, 0x0000ff, 0x00ff00, 0xff0000, 0)) {
+			return(NULL);
+		}
 	}
 
 	/* Set up the new mode framebuffer */
 	current->flags = SDL_FULLSCREEN;
+	if ( SIXEL_bpp == 1 ) {
+		current->flags |= SDL_HWPALETTE;
+	}
+	SIXEL_resizable = ((flags & SDL_RESIZABLE) != 0);
+	if ( SIXEL_resizable ) {
+		current->flags |= SDL_RESIZABLE;
+	}
+	SIXEL_resize_pending = 0;
 	SIXEL_w = current->w = width;
 	SIXEL_h = current->h = height;
-	SIXEL_pixel_w = 0;
-	SIXEL_pixel_h = 0;
+	SIXEL_pixel_w = SIXEL_term_pixel_w;
+	SIXEL_pixel_h = SIXEL_term_pixel_h;
 	SIXEL_cell_w = 0;
 	SIXEL_cell_h = 0;
 	SIXEL_mouse_x = width / 2;
 	SIXEL_mouse_y = height / 2;
 	SIXEL_mouse_button = 0;
+	SIXEL_mouse_posted_x = -1;
+	SIXEL_mouse_posted_y = -1;
 	SIXEL_update_rect.x = -1;
 	SIXEL_update_rect.y = -1;
 	SIXEL_update_rect.w = -1;
 	SIXEL_update_rect.h = -1;
 #if SDL_VIDEO_OPENGL_OSMESA
-	SIXEL_glcontext = OSMesaCreateContextExt(GL_RGB, 24, 0, 0, NULL);
+	if ( SIXEL_bpp == 3 ) {
+		SIXEL_glcontext = OSMesaCreateContextExt(GL_RGB, 24, 0, 0, NULL);
+	}
+	if ( (flags & SDL_OPENGL) && this->gl_config.double_buffer ) {
+		SIXEL_glbuffer = calloc(1, width * height * SIXEL_bpp);
+		if ( ! SIXEL_glbuffer ) {
+			SDL_SetError("Couldn't allocate buffer for requested mode");
+			return(NULL);
+		}
+	}
 #endif
-	current->pitch = width * 3;
+	current->pitch = width * SIXEL_bpp;
 	current->pixels = SIXEL_buffer;
 #if SDL_VIDEO_OPENGL_OSMESA
-	current->flags |= SDL_OPENGL;
+	if ( SIXEL_bpp == 3 ) {
+		current->flags |= SDL_OPENGL;
+	}
 #endif
 
+	if ( SIXEL_async && SIXEL_StartEncoder(this) < 0 ) {
+		return(NULL);
+	}
+
+	SIXEL_CaptureMode(this);
+
 	/* Set the blit function */
 	this->UpdateRects = SIXEL_UpdateRects;
 
-	printf("\033[14t\033[18t\n");
+	if ( ! SIXEL_headless ) {
+		SDL_mutexP(SIXEL_mutex);
+		SIXEL_WriteBytes(this, "\033[14t\033[18t\n", 11);
+		SIXEL_FlushWriter(this);
+		SDL_mutexV(SIXEL_mutex);
+	}
 
 	/* We're done */
 	return(current);
@@ -337,75 +595,290 @@ static void SIXEL_UnlockHWSurface(_THIS, SDL_Surface *surface)
 
 static void SIXEL_SetCaption(_THIS, const char *title, const char *icon)
 {
-	printf("\033]1;%s\033\\", icon);
-	printf("\033]2;%s\033\\", title);
+	/* A recording has no window to name */
+	if ( SIXEL_headless ) {
+		return;
+	}
+	SDL_mutexP(SIXEL_mutex);
+	if ( icon ) {
+		SIXEL_WriteBytes(this, "\033]1;", 4);
+		SIXEL_WriteBytes(this, icon, SDL_strlen(icon));
+		SIXEL_WriteBytes(this, "\033\\", 2);
+	}
+	if ( title ) {
+		SIXEL_WriteBytes(this, "\033]2;", 4);
+		SIXEL_WriteBytes(this, title, SDL_strlen(title));
+		SIXEL_WriteBytes(this, "\033\\", 2);
+	}
+	SIXEL_FlushWriter(this);
+	SDL_mutexV(SIXEL_mutex);
+}
+
+/* Hand the rectangles over to the encoder thread, or encode them now */
+static void SIXEL_SubmitRects(_THIS, int numrects, SDL_Rect *rects)
+{
+	int pending, ready;
+	Uint64 start, elapsed;
+
+	SIXEL_UpdateScale(this);
+	if ( SIXEL_async ) {
+		start = SIXEL_GetMicroseconds();
+		if ( SIXEL_diff ) {
+			SIXEL_DetectScroll(this, numrects, rects);
+			numrects = SIXEL_DiffRects(this, numrects, rects, &rects);
+			numrects = SIXEL_ScrollCursor(this, numrects, rects, &rects);
+		}
+		numrects = SIXEL_CoalesceRects(this, numrects, rects, &rects);
+		elapsed = SIXEL_GetMicroseconds() - start;
+		SDL_mutexP(SIXEL_mutex);
+		SIXEL_stats.diff_us += elapsed;
+		SDL_mutexV(SIXEL_mutex);
+		if ( numrects > 0 || SIXEL_nscrolls > 0 ) {
+			/* The snapshots only hold the dirty cells, the palette
+			   is worked out from the whole framebuffer here */
+			if ( numrects > 0 && SIXEL_adaptive && SIXEL_bpp != 1 ) {
+				SIXEL_AdaptPalette(this, SIXEL_buffer);
+			}
+			SIXEL_PostFrame(this, numrects, rects);
+		}
+		return;
+	}
+
+	SDL_mutexP(SIXEL_mutex);
+	pending = SIXEL_FlushWriter(this);
+	if ( SIXEL_fps > 0 ) {
+		ready = SIXEL_PaceFrame(this, pending);
+	} else {
+		ready = (pending <= SIXEL_MAX_PENDING);
+	}
+	if ( ! ready ) {
+		/* The terminal is behind, send these cells later */
+		if ( numrects > 0 ) {
+			++SIXEL_frames_dropped;
+		}
+		SIXEL_AddRects(SIXEL_deferred, &SIXEL_ndeferred, numrects, rects);
+		SDL_mutexV(SIXEL_mutex);
+		return;
+	}
+	if ( SIXEL_ndeferred > 0 ) {
+		SIXEL_AddRects(SIXEL_deferred, &SIXEL_ndeferred, numrects, rects);
+		numrects = SIXEL_ndeferred;
+		rects = SIXEL_deferred;
+		SIXEL_ndeferred = 0;
+	}
+	start = SIXEL_GetMicroseconds();
+	if ( SIXEL_diff ) {
+		SIXEL_DetectScroll(this, numrects, rects);
+		numrects = SIXEL_DiffRects(this, numrects, rects, &rects);
+		numrects = SIXEL_ScrollCursor(this, numrects, rects, &rects);
+	}
+	numrects = SIXEL_CoalesceRects(this, numrects, rects, &rects);
+	SIXEL_stats.diff_us += SIXEL_GetMicroseconds() - start;
+	if ( SIXEL_nscrolls > 0 ) {
+		SIXEL_EmitScrolls(this, SIXEL_nscrolls, SIXEL_scrolls);
+		SIXEL_nscrolls = 0;
+		if ( numrects == 0 ) {
+			SIXEL_FlushWriter(this);
+		}
+	}
+	if ( numrects > 0 ) {
+		start = SIXEL_GetMicroseconds();
+		SIXEL_EncodeRects(this, SIXEL_buffer, numrects, rects);
+		SIXEL_FlushWriter(this);
+		SIXEL_PaceEncoded(this, start);
+	}
+	SDL_mutexV(SIXEL_mutex);
+}
+
+void SIXEL_PumpOutput(_THIS)
+{
+	if ( SIXEL_ndeferred > 0 ) {
+		/* This flushes first and holds the cells back if still busy */
+		SIXEL_SubmitRects(this, 0, NULL);
+	} else {
+		SDL_mutexP(SIXEL_mutex);
+		SIXEL_FlushWriter(this);
+		SDL_mutexV(SIXEL_mutex);
+	}
+}
+
+void SIXEL_RepaintScreen(_THIS)
+{
+	SDL_Rect rect;
+
+	if ( ! SIXEL_buffer ) {
+		return;
+	}
+	SIXEL_shadow_valid = 0;
+	rect.x = 0;
+	rect.y = 0;
+	rect.w = SIXEL_w;
+	rect.h = SIXEL_h;
+	SIXEL_SubmitRects(this, 1, &rect);
 }
 
 static int SIXEL_FlipHWSurface(_THIS, SDL_Surface *surface)
 {
-	int start_row = 1;
-	int start_col = 1;
+	SDL_Rect rect;
 
-	memcpy(SIXEL_bitmap, SIXEL_buffer, SIXEL_h * SIXEL_w * 3);
-	printf("\033[%d;%dH", start_row, start_col);
-	sixel_encode(SIXEL_bitmap, SIXEL_w, SIXEL_h, 3, SIXEL_dither, SIXEL_output);
-	fflush(stdout);
+	rect.x = 0;
+	rect.y = 0;
+	rect.w = SIXEL_w;
+	rect.h = SIXEL_h;
+	SIXEL_CaptureFrame(this, 1, &rect);
+	SIXEL_SubmitRects(this, 1, &rect);
 
 	return 0;
 }
 
-static void SIXEL_UpdateRects(_THIS, int numrects, SDL_Rect *rects)
+/* Align a rectangle to the character cells of the terminal */
+void SIXEL_SnapRect(_THIS, SDL_Rect *rect)
 {
 	int start_row = 1, start_col = 1;
-	int cell_height = 0, cell_width = 0;
-	int i, y;
-	unsigned char *src, *dst;
+	int cell_height, cell_width;
+
+	cell_height = SIXEL_scale_cell_h;
+	cell_width = SIXEL_scale_cell_w;
+	start_row += rect->y / cell_height;
+	start_col += rect->x / cell_width;
+	rect->h += rect->y - (start_row - 1) * cell_height;
+	rect->w += rect->x - (start_col - 1) * cell_width;
+	rect->y = (start_row - 1) * cell_height;
+	rect->x = (start_col - 1) * cell_width;
+	rect->h = min(((rect->y + rect->h) / cell_height + 1) * cell_height, SIXEL_h) - rect->y;
+	rect->w = min(((rect->x + rect->w) / cell_width + 1) * cell_width, SIXEL_w) - rect->x;
+}
+
+void SIXEL_EncodeRect(_THIS, const Uint8 *pixels, int pitch, const SDL_Rect *rects)
+{
+	int start_row, start_col;
+	int len, y;
+	const Uint8 *src;
+	Uint8 *packed;
+	char seq[64];
+	SDL_Rect rect;
+
+	if ( SIXEL_scaled ) {
+		SIXEL_ScaleRect(this, pixels, pitch, rects, &rect);
+		pitch = SIXEL_scale_w * SIXEL_bpp;
+		src = SIXEL_scale_buffer + rect.y * pitch + rect.x * SIXEL_bpp;
+	} else {
+		rect = *rects;
+		src = pixels;
+	}
+	start_row = 1;
+	start_col = 1;
+	if ( SIXEL_scale_cell_h != 0 ) {
+		start_row += rect.y / SIXEL_scale_term_h;
+		start_col += rect.x / SIXEL_scale_term_w;
+	}
+	len = SDL_snprintf(seq, sizeof(seq), "\033[%d;%dH", start_row, start_col);
+	SIXEL_WriteBytes(this, seq, len);
+	if ( ! SIXEL_libsixel ) {
+		SIXEL_EncodeStrided(this, src, pitch, rect.w, rect.h);
+		return;
+	}
+	if ( pitch != rect.w * 3 ) {
+		/* libsixel wants the rows packed, full rows already are */
+		if ( SIXEL_packed_size < rect.h * rect.w * 3 ) {
+			packed = (Uint8 *)realloc(SIXEL_packed, rect.h * rect.w * 3);
+			if ( ! packed ) {
+				SDL_OutOfMemory();
+				return;
+			}
+			SIXEL_packed = packed;
+			SIXEL_packed_size = rect.h * rect.w * 3;
+		}
+		for ( y = 0; y < rect.h; ++y ) {
+			memcpy(SIXEL_packed + y * rect.w * 3, src + y * pitch, rect.w * 3);
+		}
+		src = SIXEL_packed;
+	}
+	sixel_encode((unsigned char *)src, rect.w, rect.h, 3,
+	             SIXEL_dither, SIXEL_output);
+}
+
+void SIXEL_EncodeRects(_THIS, unsigned char *pixels, int numrects, SDL_Rect *rects)
+{
+	int pitch = SIXEL_w * SIXEL_bpp;
+	int i;
+	Uint64 start = SIXEL_GetMicroseconds();
 #if SIXEL_VIDEO_DEBUG
 	static int frames = 0;
 	char *format;
+	char seq[64];
+	int len;
 #endif
-	SDL_mutexP(SIXEL_mutex);
 
-	if ( SIXEL_cell_h != 0 && SIXEL_pixel_h != 0 ) {
-		for (i = 0; i < numrects; ++i, ++rects) {
-			start_row = 1;
-			start_col = 1;
-			cell_height = SIXEL_pixel_h / SIXEL_cell_h;
-			cell_width = SIXEL_pixel_w / SIXEL_cell_w;
-			start_row += rects->y / cell_height;
-			start_col += rects->x / cell_width;
-			rects->h += rects->y - (start_row - 1) * cell_height;
-			rects->w += rects->x - (start_col - 1) * cell_width;
-			rects->y = (start_row - 1) * cell_height;
-			rects->x = (start_col - 1) * cell_width;
-			rects->h = min(((rects->y + rects->h) / cell_height + 1) * cell_height, SIXEL_h) - rects->y;
-			rects->w = min(((rects->x + rects->w) / cell_width + 1) * cell_width, SIXEL_w) - rects->x;
-
-			if ( rects->x == 0 && rects->w == SIXEL_w ) {
-				dst = SIXEL_bitmap;
-				src = SIXEL_buffer + rects->y * SIXEL_w * 3;
-				memcpy(dst, src, rects->h * SIXEL_w * 3);
-			} else {
-				for (y = rects->y; y < rects->y + rects->h; ++y) {
-					dst = SIXEL_bitmap + (y - rects->y) * rects->w * 3;
-					src = SIXEL_buffer + y * SIXEL_w * 3 + rects->x * 3;
-					memcpy(dst, src, rects->w * 3);
-				}
-			}
-			printf("\033[%d;%dH", start_row, start_col);
-			sixel_encode(SIXEL_bitmap, rects->w, rects->h, 3, SIXEL_dither, SIXEL_output);
+	if ( SIXEL_adaptive && SIXEL_bpp != 1 && ! SIXEL_async ) {
+		SIXEL_AdaptPalette(this, pixels);
+	}
+
+	for (i = 0; i < numrects; ++i) {
+		SIXEL_EncodeRect(this, pixels + rects[i].y * pitch + rects[i].x * SIXEL_bpp,
+		                 pitch, &rects[i]);
 #if SIXEL_VIDEO_DEBUG
-			format = "\033[100;1Hframes: %05d, x: %04d, y: %04d, w: %04d, h: %04d";
-			printf(format, ++frames, rects->x, rects->y, rects->w, rects->h);
+		format = "\033[100;1Hframes: %05d, x: %04d, y: %04d, w: %04d, h: %04d";
+		len = SDL_snprintf(seq, sizeof(seq), format, ++frames, rects[i].x, rects[i].y, rects[i].w, rects[i].h);
+		SIXEL_WriteBytes(this, seq, len);
 #endif
+	}
+	SIXEL_StatsFrame(this, numrects, start);
+
+	/* The pointer goes back over whatever was painted under it */
+	SIXEL_RepaintCursor(this, numrects, rects);
+	SIXEL_EndFrame(this);
+}
+
+static void SIXEL_UpdateRects(_THIS, int numrects, SDL_Rect *rects)
+{
+	SDL_Rect rect;
+	int i;
+
+	/* Recorded as the application asked for them, before snapping */
+	SIXEL_CaptureFrame(this, numrects, rects);
+	SIXEL_UpdateScale(this);
+	if ( SIXEL_scale_cell_h != 0 ) {
+		for (i = 0; i < numrects; ++i) {
+			SIXEL_SnapRect(this, &rects[i]);
 		}
 	} else {
-		memcpy(SIXEL_bitmap, SIXEL_buffer, SIXEL_h * SIXEL_w * 3);
-		printf("\033[%d;1H", start_row);
-		sixel_encode(SIXEL_bitmap, SIXEL_w, SIXEL_h, 3, SIXEL_dither, SIXEL_output);
+		rect.x = 0;
+		rect.y = 0;
+		rect.w = SIXEL_w;
+		rect.h = SIXEL_h;
+		numrects = 1;
+		rects = &rect;
+	}
+	SIXEL_SubmitRects(this, numrects, rects);
+}
+
+static int SIXEL_SetColors(_THIS, int firstcolor, int ncolors, SDL_Color *colors)
+{
+	Uint8 *entry;
+	int i, changed;
+
+	if ( SIXEL_bpp != 1 ) {
+		return(0);
+	}
+	SIXEL_CapturePalette(this, firstcolor, ncolors, colors);
+	SDL_mutexP(SIXEL_mutex);
+	changed = 0;
+	entry = SIXEL_palette + firstcolor * 3;
+	for ( i = 0; i < ncolors && ! changed; ++i, entry += 3 ) {
+		changed = (entry[0] != colors[i].r || entry[1] != colors[i].g ||
+		           entry[2] != colors[i].b);
+	}
+	if ( changed ) {
+		SIXEL_SetPalette(this, firstcolor, ncolors, colors);
 	}
-	fflush(stdout);
 	SDL_mutexV(SIXEL_mutex);
+
+	/* The terminal keeps colors, not indices, so everything is redrawn */
+	if ( changed ) {
+		SIXEL_RepaintScreen(this);
+	}
+	return(1);
 }
 
 /* Note:  If we are terminated, this could be called in the middle of
@@ -415,19 +888,61 @@ void SIXEL_VideoQuit(_THIS)
 {
 	int i;
 
-	tty_restore();
+	if ( SIXEL_async ) {
+		SIXEL_StopEncoder(this);
+		SDL_DestroyCond(SIXEL_mailbox_cond);
+		SDL_DestroyMutex(SIXEL_mailbox_lock);
+		SIXEL_async = 0;
+	}
 
-	printf("\033\\");
+	/* Show the last picture even if pacing held it back */
+	if ( SIXEL_ndeferred > 0 && SIXEL_buffer ) {
+		SDL_mutexP(SIXEL_mutex);
+		SIXEL_EncodeRects(this, SIXEL_buffer, SIXEL_ndeferred, SIXEL_deferred);
+		SIXEL_ndeferred = 0;
+		SDL_mutexV(SIXEL_mutex);
+	}
+	SIXEL_FreeDiff(this);
+	SIXEL_FreeScroll(this);
+	SIXEL_FreeScale(this);
+	SIXEL_FreeCursor(this);
+	SIXEL_FreeCoalesce(this);
+	SIXEL_QuitEncoder(this);
+	SIXEL_CloseWriter(this);
+	SIXEL_QuitStats(this);
+	SIXEL_CloseCapture(this);
+	SIXEL_StopInput(this);
+	SIXEL_UnwatchResize(this);
+
+	if ( ! SIXEL_headless ) {
+		tty_restore();
+
+		printf("\033\\");
 #if USE_DECMOUSE
 #else
-	printf("\033[?1006l");
+		if ( SIXEL_mouse_pixels ) {
+			printf("\033[?1016l");
+		}
+		printf("\033[?1006l");
 #endif
-	printf("\033[>0p");
-	printf("\033[?1003l");
-	printf("\033[?25h");
+		printf("\033[>0p");
+		printf("\033[?1003l");
+		printf("\033[?25h");
+	}
 
 	sixel_dither_unref(SIXEL_dither);
 	sixel_output_unref(SIXEL_output);
+	if ( SIXEL_packed ) {
+		free(SIXEL_packed);
+		SIXEL_packed = NULL;
+	}
+	SIXEL_packed_size = 0;
+#if SDL_VIDEO_OPENGL_OSMESA
+	if ( SIXEL_glbuffer ) {
+		free(SIXEL_glbuffer);
+		SIXEL_glbuffer = NULL;
+	}
+#endif
 
 	/* Free video mode lists */
 	for ( i=0; i<SDL_NUMMODES; ++i ) {
@@ -440,64 +955,66 @@ void SIXEL_VideoQuit(_THIS)
 	SDL_DestroyMutex(SIXEL_mutex);
 }
 
-typedef struct sixel_gl_funcmap
-{
-	const char *name;
-	void *func;
-} sixel_gl_funcmap_t;
-
 #if SDL_VIDEO_OPENGL_OSMESA
 void SIXEL_GL_SwapBuffers(_THIS)
 {
-	int start_row = 1;
-	int start_col = 1;
-
-	glFlush();
-	memcpy(SIXEL_bitmap, SIXEL_buffer, SIXEL_h * SIXEL_w * 3);
-	printf("\033[%d;%dH", start_row, start_col);
-	sixel_encode(SIXEL_bitmap, SIXEL_w, SIXEL_h, 3, SIXEL_dither, SIXEL_output);
+	SDL_Rect rect;
+	GLint box[4];
+	unsigned char *front;
+	int y, pitch = SIXEL_w * SIXEL_bpp;
+
+	rect.x = 0;
+	rect.y = 0;
+	rect.w = SIXEL_w;
+	rect.h = SIXEL_h;
+	if ( SIXEL_glscissor && glIsEnabled(GL_SCISSOR_TEST) ) {
+		/* The application promises it only drew in the scissor box.
+		   OSMesa stores the bottom row first, so GL rows are rows of
+		   the buffer as they are. */
+		glGetIntegerv(GL_SCISSOR_BOX, box);
+		box[2] = SDL_min(box[0] + box[2], SIXEL_w);
+		box[3] = SDL_min(box[1] + box[3], SIXEL_h);
+		box[0] = SDL_max(box[0], 0);
+		box[1] = SDL_max(box[1], 0);
+		if ( box[2] <= box[0] || box[3] <= box[1] ) {
+			return;
+		}
+		rect.x = box[0];
+		rect.y = box[1];
+		rect.w = box[2] - box[0];
+		rect.h = box[3] - box[1];
+	}
+	glFinish();
+
+	if ( SIXEL_glbuffer ) {
+		/* Show the frame just drawn and draw the next one in the other
+		   buffer, so the framebuffer always holds a whole frame for
+		   whatever is still to be encoded from it */
+		front = SIXEL_glbuffer;
+		SIXEL_glbuffer = SIXEL_buffer;
+		SIXEL_buffer = front;
+		this->screen->pixels = SIXEL_buffer;
+		if ( SIXEL_glscissor ) {
+			/* Partial updates draw over the previous frame */
+			for ( y = rect.y; y < rect.y + rect.h; ++y ) {
+				memcpy(SIXEL_glbuffer + y * pitch + rect.x * SIXEL_bpp,
+				       SIXEL_buffer + y * pitch + rect.x * SIXEL_bpp,
+				       rect.w * SIXEL_bpp);
+			}
+		}
+		OSMesaMakeCurrent(SIXEL_glcontext, SIXEL_glbuffer,
+		                  GL_UNSIGNED_BYTE, SIXEL_w, SIXEL_h);
+	}
+	SIXEL_CaptureFrame(this, 1, &rect);
+	SIXEL_SubmitRects(this, 1, &rect);
 }
 #endif
 
 #if SDL_VIDEO_OPENGL_OSMESA
+/* Mesa knows every entry point it has, and looks them up in a hash table */
 void *SIXEL_GL_GetProcAddress(_THIS, const char* proc)
 {
-	int i;
-	static sixel_gl_funcmap_t map[] = {
-		{"glBegin", glBegin},
-		{"glBindTexture", glBindTexture},
-		{"glBlendFunc", glBlendFunc},
-		{"glColor4f", glColor4f},
-		{"glDisable", glDisable},
-		{"glEnable", glEnable},
-		{"glEnd", glEnd},
-		{"glFlush", glFlush},
-		{"glGenTextures", glGenTextures},
-		{"glGetString", glGetString},
-		{"glLoadIdentity", glLoadIdentity},
-		{"glMatrixMode", glMatrixMode},
-		{"glOrtho", glOrtho},
-		{"glPixelStorei", glPixelStorei},
-		{"glPopAttrib", glPopAttrib},
-		{"glPopClientAttrib", glPopClientAttrib},
-		{"glPopMatrix", glPopMatrix},
-		{"glPushAttrib", glPushAttrib},
-		{"glPushClientAttrib", glPushClientAttrib},
-		{"glPushMatrix", glPushMatrix},
-		{"glTexCoord2f", glTexCoord2f},
-		{"glTexEnvf", glTexEnvf},
-		{"glTexImage2D", glTexImage2D},
-		{"glTexParameteri", glTexParameteri},
-		{"glTexSubImage2D", glTexSubImage2D},
-		{"glVertex2i", glVertex2i},
-		{"glViewport", glViewport},
-	};
-	for (i = 0; i < sizeof(map) / sizeof(map[0]); i++) {
-		if (strcmp(map[i].name, proc) == 0) {
-			return map[i].func;
-		}
-	}
-	return NULL;
+	return (void *)OSMesaGetProcAddress(proc);
 }
 #endif
 
@@ -580,7 +1097,9 @@ int SIXEL_GL_MakeCurrent(_THIS)
 		SDL_SetError("Unable to make GL context current 1");
 		retval = -1;
 	}
-	if ( ! OSMesaMakeCurrent(SIXEL_glcontext, (void*)SIXEL_buffer, GL_UNSIGNED_BYTE, SIXEL_w, SIXEL_h)) {
+	if ( ! OSMesaMakeCurrent(SIXEL_glcontext,
+	                         SIXEL_glbuffer ? (void*)SIXEL_glbuffer : (void*)SIXEL_buffer,
+	                         GL_UNSIGNED_BYTE, SIXEL_w, SIXEL_h)) {
 		SDL_SetError("Unable to make GL context current 2");
 		retval = -1;
 	}
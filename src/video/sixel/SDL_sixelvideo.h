@@ -26,7 +26,10 @@
 #include "SDL_mouse.h"
 #include "../SDL_sysvideo.h"
 #include "SDL_mutex.h"
+#include "SDL_thread.h"
+#include "SDL_sixel.h"
 
+#include <stdio.h>
 #include <sys/time.h>
 #include <time.h>
 
@@ -37,6 +40,96 @@
 
 #define SDL_NUMMODES 6
 
+/* Number of frame slots in the asynchronous encoder mailbox */
+#define SIXEL_NUMFRAMES 3
+/* Number of dirty rectangles a frame slot can hold before collapsing */
+#define SIXEL_MAXRECTS 64
+/* Number of terminal side scrolls a frame can carry */
+#define SIXEL_MAXSCROLLS 8
+
+/* Ways of scrolling the picture in the terminal, see SDL_sixelscroll.c */
+#define SIXEL_SCROLL_REGION 1
+#define SIXEL_SCROLL_DECCRA 2
+
+/* Fixed cost of a separate sixel image (DCS header, palette and cursor
+   positioning), expressed in the number of pixels it takes as long to encode
+   and send.
+*/
+#define SIXEL_RECT_OVERHEAD 4096
+
+/* Initial size of the in-tree encoder's output buffers */
+#define SIXEL_OUTBUF_SIZE 16384
+/* Output backlog beyond which updates are held back */
+#define SIXEL_MAX_PENDING (256 * 1024)
+/* Milliseconds to wait at a time for the terminal to take more output */
+#define SIXEL_WRITE_WAIT 100
+/* Milliseconds the output gets to drain at shutdown before it is dropped */
+#define SIXEL_CLOSE_WAIT 2000
+/* Minimum number of sixel bands given to each encoding thread */
+#define SIXEL_MIN_BANDS 4
+/* Number of entries of the 5:5:5 color lookup table */
+#define SIXEL_LUT_SIZE (1 << 15)
+/* Number of 4:4:4 bins of the histogram watched by the adaptive palette */
+#define SIXEL_HIST_SIZE (1 << 12)
+/* Number of frames between two looks at the histogram */
+#define SIXEL_PALETTE_INTERVAL 8
+/* Number of parsed keys waiting to be pumped, a power of two */
+#define SIXEL_INPUT_QUEUE 256
+
+/* A growable byte buffer */
+typedef struct sixel_buffer {
+	char *data;
+	int len;
+	int size;
+} sixel_buffer_t;
+
+/* Scratch space and output of an in-tree encoder context */
+typedef struct sixel_context {
+	Uint8 *band;
+	Uint8 *sixels;
+	char *out;
+	int outlen;
+	int outsize;
+	int error;
+	Uint64 quantize_time;
+} sixel_context_t;
+
+/* A thread encoding a group of bands of an image, or the calling thread
+   doing it in its place once the thread failed */
+typedef struct sixel_worker {
+	struct SDL_VideoDevice *device;
+	SDL_Thread *thread;
+	SDL_sem *start;
+	int failed;
+	sixel_context_t ctx;
+	const Uint8 *pixels;
+	int pitch, w, h;
+	int y1, y2;
+} sixel_worker_t;
+
+/* A key or control sequence sent by the terminal */
+typedef struct _key {
+	int params[16];
+	int nparams;
+	int value;
+} sixel_key_t;
+
+/* Rows [top, bottom) of columns [left, right) moved up lines, or down */
+typedef struct sixel_scroll {
+	int top, bottom;
+	int left, right;
+	int lines;
+} sixel_scroll_t;
+
+/* A snapshot of the dirty regions of the framebuffer */
+typedef struct sixel_frame {
+	unsigned char *pixels;
+	int numrects;
+	SDL_Rect rects[SIXEL_MAXRECTS];
+	int nscrolls;
+	sixel_scroll_t scrolls[SIXEL_MAXSCROLLS];
+} sixel_frame_t;
+
 /* Private display data */
 struct SDL_PrivateVideoData {
 	SDL_Rect *SDL_modelist[SDL_NUMMODES+1];
@@ -45,23 +138,168 @@ struct SDL_PrivateVideoData {
 	sixel_dither_t *dither;
 	sixel_output_t *output;
 
-	unsigned char *bitmap;
+	/* Encoder picked at mode set for every rectangle, and the packed
+	   copy of a partial rectangle that libsixel needs */
+	int libsixel;
+	Uint8 *packed;
+	int packed_size;
+
 	unsigned char *buffer;
 	int w, h;
 	int pixel_w, pixel_h;
 	int cell_w, cell_h;
 	int mouse_x, mouse_y;
 	int mouse_button;
+	int mouse_posted_x, mouse_posted_y;
+	int mouse_pixels;
 	SDL_Rect update_rect;
+
+	/* Bytes per pixel of the framebuffer, 3, 4 for XRGB or 1 for indexed */
+	int bpp;
+
+	/* In-tree strided encoder */
+	int builtin;
+	Uint8 palette[256 * 3];
+	Uint8 *lut;
+	int lut_default;
+	int nthreads;
+	int nworkers;
+	sixel_worker_t *workers;
+	SDL_sem *workers_done;
+	int workers_quit;
+
+	/* Palette built from the picture, kept until the colors drift */
+	int adaptive;
+	int palette_drift;
+	int palette_age;
+	int palette_warmup;
+	Uint32 *histogram;
+	Uint8 *samples;
+
+	/* Asynchronous encoder thread */
+	int async;
+	SDL_Thread *encoder;
+	SDL_mutex *mailbox_lock;
+	SDL_cond *mailbox_cond;
+	sixel_frame_t frames[SIXEL_NUMFRAMES];
+	int frame_free, frame_pending, frame_encoding;
+	int frame_ready;
+	int encoder_quit;
+
+	/* Tile differencing against the last frame sent */
+	int diff;
+	unsigned char *shadow;
+	int shadow_valid;
+	Uint8 *tiles;
+	SDL_Rect *tile_rects;
+	int *tile_spans;
+	int tile_w, tile_h;
+	int tile_cols, tile_rows;
+
+	/* Scaling down to the terminal size */
+	double scale_factor;
+	int scaled;
+	int scale_cell_w, scale_cell_h;
+	int scale_term_w, scale_term_h;
+	int scale_w, scale_h;
+	Uint8 *scale_buffer;
+	Uint8 *scale_row;
+	int *scale_cols;
+
+	/* Scroll detection */
+	int scroll;
+	Uint32 *row_hashes;
+	int hashes_valid;
+	int nscrolls;
+	sixel_scroll_t scrolls[SIXEL_MAXSCROLLS];
+
+	/* Terminal input */
+	SDL_Thread *input_thread;
+	int input_wake[2];
+	sixel_key_t input_queue[SIXEL_INPUT_QUEUE];
+	volatile unsigned int input_head;
+	volatile unsigned int input_tail;
+	volatile int input_stalled;
+	volatile int input_quit;
+	int input_state;
+	int input_ibytes;
+	int input_pbytes;
+
+	/* Terminal capabilities, probed or read from its profile */
+	int probe_pending;
+	int term_sixel;
+	int term_colors;
+	int term_max_w, term_max_h;
+	int term_mouse_pixels;
+	int term_pixel_w, term_pixel_h;
+
+	/* Window size changes, reported as SDL_VIDEORESIZE */
+	int resizable;
+	int resize_pending;
+
+	/* Terminal output */
+	int out_fd;
+	sixel_buffer_t out_pending;
+	int out_offset;
+	sixel_buffer_t out_frame;
+	int ndeferred;
+	SDL_Rect deferred[SIXEL_MAXRECTS];
+
+	/* Output to a file and its frame index instead of a terminal */
+	int headless;
+	FILE *out_index;
+	Uint64 out_total;
+	Uint64 out_mark;
+	Uint64 out_start;
+
+	/* Frame pacing */
+	int fps;
+	Uint64 frame_interval;
+	Uint64 next_frame;
+	Uint64 encode_time;
+	Uint64 last_flush;
+	Uint32 drain_rate;
+	Uint64 rate_start;
+	int rate_frames;
+
+	/* Per-stage counters, see SDL_sixel.h */
+	SDL_SixelStats stats;
+	SDL_SixelStats stats_dumped;
+	Uint64 stats_mark;
+	Uint64 stats_time;
+	FILE *stats_file;
+
+	/* Recording of updates for offline replay */
+	FILE *capture;
+	Uint64 capture_start;
+	Uint32 capture_geometry[4];
+
+	/* Pointer drawn over the picture, see SDL_sixelmouse.c */
+	WMcursor *cursor;
+	int cursor_terminal;
+	int cursor_x, cursor_y;
+	int cursor_dirty;
+	SDL_Rect cursor_cells;
+	int cursor_cell_w, cursor_cell_h;
+	Uint8 *cursor_pixels;
+	int cursor_size;
+	SDL_Rect cursor_rects[SIXEL_MAXRECTS];
+
+	/* Scratch space for merging update rectangles */
+	SDL_Rect *merge_rects;
+	int merge_size;
 #if SDL_VIDEO_OPENGL_OSMESA
 	void *glcontext;
+	/* OpenGL draws the next frame here while the framebuffer shows the
+	   last one, unless single buffering was asked for */
+	unsigned char *glbuffer;
+	int glscissor;
 #endif
 };
 
 /* Old variable names */
 #define SDL_modelist		(this->hidden->SDL_modelist)
 #define SIXEL_palette		(this->hidden->palette)
-#define SIXEL_bitmap		(this->hidden->bitmap)
 #define SIXEL_buffer		(this->hidden->buffer)
 
 #define SIXEL_w			(this->hidden->w)
@@ -73,14 +311,157 @@ struct SDL_PrivateVideoData {
 #define SIXEL_mouse_x		(this->hidden->mouse_x)
 #define SIXEL_mouse_y		(this->hidden->mouse_y)
 #define SIXEL_mouse_button	(this->hidden->mouse_button)
+#define SIXEL_mouse_posted_x	(this->hidden->mouse_posted_x)
+#define SIXEL_mouse_posted_y	(this->hidden->mouse_posted_y)
+#define SIXEL_mouse_pixels	(this->hidden->mouse_pixels)
 
 #define SIXEL_output		(this->hidden->output)
 #define SIXEL_dither		(this->hidden->dither)
+#define SIXEL_libsixel		(this->hidden->libsixel)
+#define SIXEL_packed		(this->hidden->packed)
+#define SIXEL_packed_size	(this->hidden->packed_size)
 
 #define SIXEL_mutex		(this->hidden->mutex)
 #define SIXEL_update_rect	(this->hidden->update_rect)
+#define SIXEL_bpp		(this->hidden->bpp)
+#define SIXEL_builtin		(this->hidden->builtin)
+#define SIXEL_lut		(this->hidden->lut)
+#define SIXEL_lut_default	(this->hidden->lut_default)
+#define SIXEL_adaptive		(this->hidden->adaptive)
+#define SIXEL_palette_drift	(this->hidden->palette_drift)
+#define SIXEL_palette_age	(this->hidden->palette_age)
+#define SIXEL_palette_warmup	(this->hidden->palette_warmup)
+#define SIXEL_histogram		(this->hidden->histogram)
+#define SIXEL_samples		(this->hidden->samples)
+#define SIXEL_nthreads		(this->hidden->nthreads)
+#define SIXEL_nworkers		(this->hidden->nworkers)
+#define SIXEL_workers		(this->hidden->workers)
+#define SIXEL_workers_done	(this->hidden->workers_done)
+#define SIXEL_workers_quit	(this->hidden->workers_quit)
+
+#define SIXEL_async		(this->hidden->async)
+#define SIXEL_encoder		(this->hidden->encoder)
+#define SIXEL_mailbox_lock	(this->hidden->mailbox_lock)
+#define SIXEL_mailbox_cond	(this->hidden->mailbox_cond)
+#define SIXEL_frames		(this->hidden->frames)
+#define SIXEL_frame_free	(this->hidden->frame_free)
+#define SIXEL_frame_pending	(this->hidden->frame_pending)
+#define SIXEL_frame_encoding	(this->hidden->frame_encoding)
+#define SIXEL_frame_ready	(this->hidden->frame_ready)
+#define SIXEL_encoder_quit	(this->hidden->encoder_quit)
+
+#define SIXEL_diff		(this->hidden->diff)
+#define SIXEL_shadow		(this->hidden->shadow)
+#define SIXEL_shadow_valid	(this->hidden->shadow_valid)
+#define SIXEL_tiles		(this->hidden->tiles)
+#define SIXEL_tile_rects	(this->hidden->tile_rects)
+#define SIXEL_tile_spans	(this->hidden->tile_spans)
+#define SIXEL_tile_w		(this->hidden->tile_w)
+#define SIXEL_tile_h		(this->hidden->tile_h)
+#define SIXEL_tile_cols		(this->hidden->tile_cols)
+#define SIXEL_tile_rows		(this->hidden->tile_rows)
+#define SIXEL_scale_factor	(this->hidden->scale_factor)
+#define SIXEL_scaled		(this->hidden->scaled)
+#define SIXEL_scale_cell_w	(this->hidden->scale_cell_w)
+#define SIXEL_scale_cell_h	(this->hidden->scale_cell_h)
+#define SIXEL_scale_term_w	(this->hidden->scale_term_w)
+#define SIXEL_scale_term_h	(this->hidden->scale_term_h)
+#define SIXEL_scale_w		(this->hidden->scale_w)
+#define SIXEL_scale_h		(this->hidden->scale_h)
+#define SIXEL_scale_buffer	(this->hidden->scale_buffer)
+#define SIXEL_scale_row		(this->hidden->scale_row)
+#define SIXEL_scale_cols	(this->hidden->scale_cols)
+#define SIXEL_scroll		(this->hidden->scroll)
+#define SIXEL_row_hashes	(this->hidden->row_hashes)
+#define SIXEL_hashes_valid	(this->hidden->hashes_valid)
+#define SIXEL_nscrolls		(this->hidden->nscrolls)
+#define SIXEL_scrolls		(this->hidden->scrolls)
+#define SIXEL_input_thread	(this->hidden->input_thread)
+#define SIXEL_input_wake	(this->hidden->input_wake)
+#define SIXEL_input_queue	(this->hidden->input_queue)
+#define SIXEL_input_head	(this->hidden->input_head)
+#define SIXEL_input_tail	(this->hidden->input_tail)
+#define SIXEL_input_stalled	(this->hidden->input_stalled)
+#define SIXEL_input_quit	(this->hidden->input_quit)
+#define SIXEL_input_state	(this->hidden->input_state)
+#define SIXEL_input_ibytes	(this->hidden->input_ibytes)
+#define SIXEL_input_pbytes	(this->hidden->input_pbytes)
+#define SIXEL_probe_pending	(this->hidden->probe_pending)
+#define SIXEL_term_sixel	(this->hidden->term_sixel)
+#define SIXEL_term_colors	(this->hidden->term_colors)
+#define SIXEL_term_max_w	(this->hidden->term_max_w)
+#define SIXEL_term_max_h	(this->hidden->term_max_h)
+#define SIXEL_term_mouse_pixels	(this->hidden->term_mouse_pixels)
+#define SIXEL_term_pixel_w	(this->hidden->term_pixel_w)
+#define SIXEL_term_pixel_h	(this->hidden->term_pixel_h)
+#define SIXEL_resizable		(this->hidden->resizable)
+#define SIXEL_resize_pending	(this->hidden->resize_pending)
+#define SIXEL_out_fd		(this->hidden->out_fd)
+#define SIXEL_out_pending	(this->hidden->out_pending)
+#define SIXEL_out_offset	(this->hidden->out_offset)
+#define SIXEL_out_frame		(this->hidden->out_frame)
+#define SIXEL_ndeferred		(this->hidden->ndeferred)
+#define SIXEL_deferred		(this->hidden->deferred)
+#define SIXEL_headless		(this->hidden->headless)
+#define SIXEL_out_index		(this->hidden->out_index)
+#define SIXEL_out_total		(this->hidden->out_total)
+#define SIXEL_out_mark		(this->hidden->out_mark)
+#define SIXEL_out_start		(this->hidden->out_start)
+#define SIXEL_fps		(this->hidden->fps)
+#define SIXEL_frame_interval	(this->hidden->frame_interval)
+#define SIXEL_next_frame	(this->hidden->next_frame)
+#define SIXEL_encode_time	(this->hidden->encode_time)
+#define SIXEL_last_flush	(this->hidden->last_flush)
+#define SIXEL_drain_rate	(this->hidden->drain_rate)
+#define SIXEL_rate_start	(this->hidden->rate_start)
+#define SIXEL_rate_frames	(this->hidden->rate_frames)
+#define SIXEL_effective_fps	(this->hidden->stats.effective_fps)
+#define SIXEL_frames_dropped	(this->hidden->stats.frames_dropped)
+#define SIXEL_stats		(this->hidden->stats)
+#define SIXEL_stats_dumped	(this->hidden->stats_dumped)
+#define SIXEL_stats_mark	(this->hidden->stats_mark)
+#define SIXEL_stats_time	(this->hidden->stats_time)
+#define SIXEL_stats_file	(this->hidden->stats_file)
+#define SIXEL_capture		(this->hidden->capture)
+#define SIXEL_capture_start	(this->hidden->capture_start)
+#define SIXEL_capture_geometry	(this->hidden->capture_geometry)
+#define SIXEL_cursor		(this->hidden->cursor)
+#define SIXEL_cursor_terminal	(this->hidden->cursor_terminal)
+#define SIXEL_cursor_x		(this->hidden->cursor_x)
+#define SIXEL_cursor_y		(this->hidden->cursor_y)
+#define SIXEL_cursor_dirty	(this->hidden->cursor_dirty)
+#define SIXEL_cursor_cells	(this->hidden->cursor_cells)
+#define SIXEL_cursor_cell_w	(this->hidden->cursor_cell_w)
+#define SIXEL_cursor_cell_h	(this->hidden->cursor_cell_h)
+#define SIXEL_cursor_pixels	(this->hidden->cursor_pixels)
+#define SIXEL_cursor_size	(this->hidden->cursor_size)
+#define SIXEL_cursor_rects	(this->hidden->cursor_rects)
+#define SIXEL_merge_rects	(this->hidden->merge_rects)
+#define SIXEL_merge_size	(this->hidden->merge_size)
 #if SDL_VIDEO_OPENGL_OSMESA
 # define SIXEL_glcontext		(this->hidden->glcontext)
+# define SIXEL_glbuffer		(this->hidden->glbuffer)
+# define SIXEL_glscissor		(this->hidden->glscissor)
 #endif
 
+/* Encode the given rectangles of a framebuffer snapshot to the terminal */
+extern void SIXEL_EncodeRects(_THIS, unsigned char *pixels, int numrects, SDL_Rect *rects);
+/* Encode a single rectangle as an image of its own, leaving out the palette
+   adaptation and frame statistics.  pixels is the top left corner of the
+   rectangle, with rows pitch bytes apart.
+*/
+extern void SIXEL_EncodeRect(_THIS, const Uint8 *pixels, int pitch, const SDL_Rect *rect);
+/* Align a rectangle to the character cells of the terminal */
+extern void SIXEL_SnapRect(_THIS, SDL_Rect *rect);
+/* Work out the video modes offered for the current terminal size */
+extern int SIXEL_BuildModes(_THIS);
+
+/* A monotonic clock in microseconds */
+extern Uint64 SIXEL_GetMicroseconds(void);
+
+/* Push queued output and updates held back by a slow terminal */
+extern void SIXEL_PumpOutput(_THIS);
+/* Send the whole framebuffer again, the terminal no longer shows it */
+extern void SIXEL_RepaintScreen(_THIS);
+
 #endif /* _SDL_sixelvideo_h */
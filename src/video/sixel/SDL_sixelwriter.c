@@ -0,0 +1,346 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+
+#include "SDL_config.h"
+
+/* Terminal output for the sixel driver.
+
+   The cursor positioning and sixel data of a frame are gathered in one
+   buffer and handed to the terminal with a single writev() together with
+   whatever an earlier frame left behind.  When stdout is a terminal, it
+   is opened a second time in non-blocking mode, so a slow link leaves
+   bytes pending instead of stalling the application, and the driver can
+   look at the backlog to decide whether to skip frames.  The non-blocking
+   flag stays private to our own file description, stdin and stderr are
+   not affected.
+
+   With SDL_SIXEL_OUTPUT set there is no terminal at all: the frames go to
+   the named file, which then plays back with cat, and a frame index is
+   kept next to it in <file>.idx.  The index starts with "SIXELIDX" and
+   has one record of five native-endian Uint32 per frame: the time since
+   the writer was opened in microseconds (low, high), the offset of the
+   frame in the file (low, high) and its length.  Frames follow each other
+   without gaps, anything sent between two of them belongs to the second
+   one.  A file never blocks, so nothing is held back and frames are
+   produced as fast as they can be encoded, unless SDL_SIXEL_FPS asks for
+   pacing.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "SDL.h"
+#include "SDL_sixelvideo.h"
+#include "SDL_sixelwriter_c.h"
+#include "SDL_sixelpacing_c.h"
+
+static int SIXEL_GrowBuffer(sixel_buffer_t *buffer, int len)
+{
+	char *data;
+	int size;
+
+	if ( buffer->len + len <= buffer->size ) {
+		return(0);
+	}
+	size = buffer->size ? buffer->size * 2 : SIXEL_OUTBUF_SIZE;
+	while ( buffer->len + len > size ) {
+		size *= 2;
+	}
+	data = realloc(buffer->data, size);
+	if ( ! data ) {
+		return(-1);
+	}
+	buffer->data = data;
+	buffer->size = size;
+	return(0);
+}
+
+static void SIXEL_FreeBuffer(sixel_buffer_t *buffer)
+{
+	if ( buffer->data ) {
+		free(buffer->data);
+		buffer->data = NULL;
+	}
+	buffer->len = 0;
+	buffer->size = 0;
+}
+
+static int SIXEL_OpenOutput(_THIS, const char *file)
+{
+	char *path;
+	int len;
+
+	SIXEL_out_fd = open(file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if ( SIXEL_out_fd < 0 ) {
+		SDL_SetError("Couldn't open %s: %s", file, strerror(errno));
+		return(-1);
+	}
+	len = (int)SDL_strlen(file) + 5;
+	path = (char *)SDL_malloc(len);
+	if ( ! path ) {
+		close(SIXEL_out_fd);
+		SIXEL_out_fd = -1;
+		SDL_OutOfMemory();
+		return(-1);
+	}
+	if ( SDL_snprintf(path, len, "%s.idx", file) != len - 1 ) {
+		SDL_SetError("Couldn't name the index of %s", file);
+		SDL_free(path);
+		close(SIXEL_out_fd);
+		SIXEL_out_fd = -1;
+		return(-1);
+	}
+	SIXEL_out_index = fopen(path, "wb");
+	if ( ! SIXEL_out_index ) {
+		SDL_SetError("Couldn't open %s: %s", path, strerror(errno));
+		SDL_free(path);
+		close(SIXEL_out_fd);
+		SIXEL_out_fd = -1;
+		return(-1);
+	}
+	SDL_free(path);
+	fwrite("SIXELIDX", 1, 8, SIXEL_out_index);
+	SIXEL_out_total = 0;
+	SIXEL_out_mark = 0;
+	SIXEL_out_start = SIXEL_GetMicroseconds();
+	return(0);
+}
+
+static void SIXEL_IndexFrame(_THIS, Uint64 offset, int len)
+{
+	Uint64 now = SIXEL_GetMicroseconds() - SIXEL_out_start;
+	Uint32 record[5];
+
+	record[0] = (Uint32)now;
+	record[1] = (Uint32)(now >> 32);
+	record[2] = (Uint32)offset;
+	record[3] = (Uint32)(offset >> 32);
+	record[4] = (Uint32)len;
+	fwrite(record, sizeof(record[0]), 5, SIXEL_out_index);
+	fflush(SIXEL_out_index);
+}
+
+const char *SIXEL_OutputFile(void)
+{
+	const char *file = SDL_getenv("SDL_SIXEL_OUTPUT");
+
+	if ( file && *file ) {
+		return(file);
+	}
+	return(NULL);
+}
+
+int SIXEL_OpenWriter(_THIS)
+{
+	const char *tty;
+
+	/* Anything already written with stdio must go out first */
+	fflush(stdout);
+
+	SIXEL_out_fd = -1;
+	SIXEL_out_offset = 0;
+	if ( SIXEL_headless ) {
+		return(SIXEL_OpenOutput(this, SIXEL_OutputFile()));
+	}
+	if ( isatty(STDOUT_FILENO) && (tty = ttyname(STDOUT_FILENO)) != NULL ) {
+		SIXEL_out_fd = open(tty, O_WRONLY | O_NOCTTY | O_NONBLOCK);
+	}
+	if ( SIXEL_out_fd < 0 ) {
+		/* A pipe or a file, just write to it */
+		SIXEL_out_fd = STDOUT_FILENO;
+	}
+	return(0);
+}
+
+void SIXEL_CloseWriter(_THIS)
+{
+	Uint64 deadline = SIXEL_GetMicroseconds() + SIXEL_CLOSE_WAIT * 1000;
+
+	/* Give the terminal some time to take the rest, but not forever */
+	while ( SIXEL_FlushWriter(this) > 0 ) {
+		if ( SIXEL_GetMicroseconds() >= deadline ) {
+			SIXEL_DropWriter(this);
+			break;
+		}
+		SIXEL_WaitWriter(this, SIXEL_WRITE_WAIT);
+	}
+	if ( SIXEL_out_fd >= 0 && SIXEL_out_fd != STDOUT_FILENO ) {
+		close(SIXEL_out_fd);
+	}
+	SIXEL_out_fd = -1;
+	if ( SIXEL_out_index ) {
+		fclose(SIXEL_out_index);
+		SIXEL_out_index = NULL;
+	}
+	SIXEL_FreeBuffer(&SIXEL_out_pending);
+	SIXEL_FreeBuffer(&SIXEL_out_frame);
+}
+
+void SIXEL_WriteBytes(_THIS, const char *data, int len)
+{
+	if ( SIXEL_GrowBuffer(&SIXEL_out_frame, len) < 0 ) {
+		SDL_OutOfMemory();
+		return;
+	}
+	memcpy(SIXEL_out_frame.data + SIXEL_out_frame.len, data, len);
+	SIXEL_out_frame.len += len;
+	SIXEL_out_total += len;
+}
+
+void SIXEL_EndFrame(_THIS)
+{
+	if ( SIXEL_out_index && SIXEL_out_total > SIXEL_out_mark ) {
+		/* A file takes everything unless writing fails, and then the
+		   index is closed rather than pointing past the end of it */
+		while ( SIXEL_FlushWriter(this) > 0 && SIXEL_out_index ) {
+			continue;
+		}
+		if ( ! SIXEL_out_index ) {
+			return;
+		}
+		SIXEL_IndexFrame(this, SIXEL_out_mark,
+		                 (int)(SIXEL_out_total - SIXEL_out_mark));
+		SIXEL_out_mark = SIXEL_out_total;
+	}
+}
+
+int SIXEL_FlushWriter(_THIS)
+{
+	struct iovec iov[2];
+	int iovcnt = 0;
+	int pending, written, left;
+	Uint64 start;
+
+	pending = SIXEL_out_pending.len - SIXEL_out_offset;
+	if ( pending > 0 ) {
+		iov[iovcnt].iov_base = SIXEL_out_pending.data + SIXEL_out_offset;
+		iov[iovcnt].iov_len = pending;
+		++iovcnt;
+	}
+	if ( SIXEL_out_frame.len > 0 ) {
+		iov[iovcnt].iov_base = SIXEL_out_frame.data;
+		iov[iovcnt].iov_len = SIXEL_out_frame.len;
+		++iovcnt;
+	}
+	if ( iovcnt == 0 ) {
+		return(0);
+	}
+
+	start = SIXEL_GetMicroseconds();
+	do {
+		written = writev(SIXEL_out_fd, iov, iovcnt);
+	} while ( written < 0 && errno == EINTR );
+	SIXEL_stats.write_us += SIXEL_GetMicroseconds() - start;
+	if ( written < 0 ) {
+		if ( errno != EAGAIN && errno != EWOULDBLOCK ) {
+			/* The terminal is gone, there is no point in keeping it */
+			SDL_SetError("Couldn't write sixel output: %s",
+			             strerror(errno));
+			if ( SIXEL_out_index ) {
+				/* The offsets no longer match the file */
+				fclose(SIXEL_out_index);
+				SIXEL_out_index = NULL;
+			}
+			SIXEL_out_pending.len = 0;
+			SIXEL_out_offset = 0;
+			SIXEL_out_frame.len = 0;
+			return(0);
+		}
+		written = 0;
+	}
+	SIXEL_PaceWritten(this, written, pending);
+	SIXEL_stats.bytes += written;
+
+	/* Consume the older output first */
+	if ( written >= pending ) {
+		written -= pending;
+		SIXEL_out_pending.len = 0;
+		SIXEL_out_offset = 0;
+	} else {
+		SIXEL_out_offset += written;
+		written = 0;
+	}
+
+	/* Whatever is left of the frame joins the pending output */
+	left = SIXEL_out_frame.len - written;
+	if ( left > 0 ) {
+		if ( SIXEL_out_offset > 0 ) {
+			memmove(SIXEL_out_pending.data,
+			        SIXEL_out_pending.data + SIXEL_out_offset,
+			        SIXEL_out_pending.len - SIXEL_out_offset);
+			SIXEL_out_pending.len -= SIXEL_out_offset;
+			SIXEL_out_offset = 0;
+		}
+		if ( SIXEL_GrowBuffer(&SIXEL_out_pending, left) < 0 ) {
+			SDL_OutOfMemory();
+		} else {
+			memcpy(SIXEL_out_pending.data + SIXEL_out_pending.len,
+			       SIXEL_out_frame.data + written, left);
+			SIXEL_out_pending.len += left;
+		}
+	}
+	SIXEL_out_frame.len = 0;
+
+	/* Everything encoded so far has reached the terminal */
+	if ( SIXEL_out_pending.len == SIXEL_out_offset && SIXEL_stats_mark ) {
+		SIXEL_stats.latency_us = (Uint32)(SIXEL_GetMicroseconds() - SIXEL_stats_mark);
+		if ( SIXEL_stats.latency_us > SIXEL_stats.latency_max_us ) {
+			SIXEL_stats.latency_max_us = SIXEL_stats.latency_us;
+		}
+		SIXEL_stats_mark = 0;
+	}
+
+	return(SIXEL_out_pending.len - SIXEL_out_offset);
+}
+
+void SIXEL_WaitWriter(_THIS, int timeout)
+{
+	struct pollfd fds;
+
+	fds.fd = SIXEL_out_fd;
+	fds.events = POLLOUT;
+	fds.revents = 0;
+	while ( poll(&fds, 1, timeout) < 0 && errno == EINTR ) {
+		continue;
+	}
+}
+
+void SIXEL_DropWriter(_THIS)
+{
+	int dropped;
+
+	dropped = SIXEL_out_pending.len - SIXEL_out_offset + SIXEL_out_frame.len;
+	SIXEL_out_pending.len = 0;
+	SIXEL_out_offset = 0;
+	SIXEL_out_frame.len = 0;
+	if ( dropped > 0 ) {
+		/* A sixel image may have been cut short, end it */
+		SIXEL_WriteBytes(this, "\033\\", 2);
+		SIXEL_FlushWriter(this);
+	}
+}
@@ -0,0 +1,55 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+
+
+#include "SDL_sixelvideo.h"
+
+/* Functions exported by SDL_sixelwriter.c to the rest of the sixel driver.
+   Everything sent to the terminal while the driver runs goes through
+   here, under SIXEL_mutex, so that it is never interleaved.
+*/
+extern int SIXEL_OpenWriter(_THIS);
+extern void SIXEL_CloseWriter(_THIS);
+
+/* The file named by SDL_SIXEL_OUTPUT, or NULL when output goes to the
+   terminal.  This decides whether the driver runs headless.
+*/
+extern const char *SIXEL_OutputFile(void);
+
+/* Queue bytes as part of the frame being built */
+extern void SIXEL_WriteBytes(_THIS, const char *data, int len);
+
+/* Note in the frame index that a frame ends with the bytes queued so far,
+   once they are all in the file
+*/
+extern void SIXEL_EndFrame(_THIS);
+
+/* Send as much of the queued output as the terminal takes without
+   blocking.  Returns the number of bytes still pending.
+*/
+extern int SIXEL_FlushWriter(_THIS);
+
+/* Wait until the terminal can take more output, or timeout ms elapsed */
+extern void SIXEL_WaitWriter(_THIS, int timeout);
+
+/* Throw away the queued output, for a terminal that stopped reading */
+extern void SIXEL_DropWriter(_THIS);
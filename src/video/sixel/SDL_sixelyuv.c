@@ -0,0 +1,386 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+
+#include "SDL_config.h"
+
+/* YUV overlays for the sixel driver.
+
+   The software overlays convert the whole picture to RGB at its own size
+   and then stretch that onto the screen, and they don't work on 8-bit
+   screens at all.  Here every screen pixel of the destination rectangle
+   is worked out straight from the nearest YUV sample, without any picture
+   in between.  On 8-bit screens the YUV triplet is looked up in a table
+   giving the closest palette entry, which the encoder then sends as is.
+   Entries are only searched for when a triplet first shows up, so a
+   palette change just empties the table.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL_video.h"
+#include "SDL_endian.h"
+#include "SDL_sixelvideo.h"
+#include "SDL_sixelyuv_c.h"
+#include "../SDL_yuvfuncs.h"
+
+/* Bits of Y, U and V indexing the palette lookup table */
+#define SIXEL_YUV_YBITS	6
+#define SIXEL_YUV_CBITS	5
+#define SIXEL_YUV_LUT_SIZE	(1 << (SIXEL_YUV_YBITS + 2 * SIXEL_YUV_CBITS))
+
+/* Lookup table entry not searched for yet */
+#define SIXEL_YUV_UNSET	0xFFFF
+
+static struct private_yuvhwfuncs sixel_yuvfuncs = {
+	SIXEL_LockYUVOverlay,
+	SIXEL_UnlockYUVOverlay,
+	SIXEL_DisplayYUVOverlay,
+	SIXEL_FreeYUVOverlay
+};
+
+struct private_yuvhwdata {
+	SDL_Surface *display;
+	Uint8 *pixels;
+
+	/* These are just so we don't have to allocate them separately */
+	Uint16 pitches[3];
+	Uint8 *planes[3];
+
+	/* Offsets of the luma and chroma samples for each screen column */
+	int *cols;
+	int ncols;
+
+	/* Palette entry of every YUV triplet, for 8-bit screens */
+	Uint16 *lut;
+	SDL_Color palette[256];
+	int ncolors;
+};
+
+/* ITU-R BT.601 with studio swing, in 8.8 fixed point */
+static int sixel_y_tab[256];
+static int sixel_rv_tab[256];
+static int sixel_gu_tab[256];
+static int sixel_gv_tab[256];
+static int sixel_bu_tab[256];
+
+static void SIXEL_InitYUVTables(void)
+{
+	int i;
+
+	for ( i = 0; i < 256; ++i ) {
+		sixel_y_tab[i] = 298 * (i - 16) + 128;
+		sixel_rv_tab[i] = 409 * (i - 128);
+		sixel_gu_tab[i] = -100 * (i - 128);
+		sixel_gv_tab[i] = -208 * (i - 128);
+		sixel_bu_tab[i] = 516 * (i - 128);
+	}
+}
+
+static __inline__ int SIXEL_Clamp(int value)
+{
+	value >>= 8;
+	return(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+static Uint16 SIXEL_MatchYUV(struct private_yuvhwdata *hwdata, int index)
+{
+	SDL_Color *colors = hwdata->palette;
+	int y, u, v, i, l, r, g, b;
+	int dist, best, best_dist;
+
+	y = index >> (2 * SIXEL_YUV_CBITS);
+	u = (index >> SIXEL_YUV_CBITS) & ((1 << SIXEL_YUV_CBITS) - 1);
+	v = index & ((1 << SIXEL_YUV_CBITS) - 1);
+
+	l = sixel_y_tab[(y << (8 - SIXEL_YUV_YBITS)) + (1 << (7 - SIXEL_YUV_YBITS))];
+	i = (u << (8 - SIXEL_YUV_CBITS)) + (1 << (7 - SIXEL_YUV_CBITS));
+	b = SIXEL_Clamp(l + sixel_bu_tab[i]);
+	g = l + sixel_gu_tab[i];
+	i = (v << (8 - SIXEL_YUV_CBITS)) + (1 << (7 - SIXEL_YUV_CBITS));
+	g = SIXEL_Clamp(g + sixel_gv_tab[i]);
+	r = SIXEL_Clamp(l + sixel_rv_tab[i]);
+
+	best = 0;
+	best_dist = 0x7fffffff;
+	for ( i = 0; i < hwdata->ncolors && best_dist > 0; ++i ) {
+		dist = (r - colors[i].r) * (r - colors[i].r) +
+		       (g - colors[i].g) * (g - colors[i].g) +
+		       (b - colors[i].b) * (b - colors[i].b);
+		if ( dist < best_dist ) {
+			best = i;
+			best_dist = dist;
+		}
+	}
+	hwdata->lut[index] = best;
+	return(best);
+}
+
+SDL_Overlay *SIXEL_CreateYUVOverlay(_THIS, int width, int height, Uint32 format, SDL_Surface *display)
+{
+	SDL_Overlay *overlay;
+	struct private_yuvhwdata *hwdata;
+	int bpp = display->format->BytesPerPixel;
+
+	/* Anything else goes to the software overlays */
+	if ( bpp != 1 && bpp != 3 && bpp != 4 ) {
+		return(NULL);
+	}
+	switch (format) {
+	    case SDL_YV12_OVERLAY:
+	    case SDL_IYUV_OVERLAY:
+	    case SDL_YUY2_OVERLAY:
+	    case SDL_UYVY_OVERLAY:
+	    case SDL_YVYU_OVERLAY:
+		break;
+	    default:
+		return(NULL);
+	}
+
+	/* Create the overlay structure */
+	overlay = (SDL_Overlay *)SDL_calloc(1, sizeof(*overlay));
+	if ( overlay == NULL ) {
+		SDL_OutOfMemory();
+		return(NULL);
+	}
+	overlay->format = format;
+	overlay->w = width;
+	overlay->h = height;
+	overlay->hwfuncs = &sixel_yuvfuncs;
+	/* Converted in software, terminals have no overlays */
+	overlay->hw_overlay = 0;
+
+	hwdata = (struct private_yuvhwdata *)SDL_calloc(1, sizeof(*hwdata));
+	overlay->hwdata = hwdata;
+	if ( hwdata == NULL ) {
+		SDL_FreeYUVOverlay(overlay);
+		SDL_OutOfMemory();
+		return(NULL);
+	}
+	hwdata->display = display;
+	hwdata->pixels = (Uint8 *)SDL_malloc(width * height * 2);
+	hwdata->cols = (int *)SDL_malloc(2 * display->w * sizeof(*hwdata->cols));
+	hwdata->ncols = display->w;
+	if ( bpp == 1 ) {
+		hwdata->lut = (Uint16 *)SDL_malloc(SIXEL_YUV_LUT_SIZE * sizeof(*hwdata->lut));
+	}
+	if ( ! hwdata->pixels || ! hwdata->cols || (bpp == 1 && ! hwdata->lut) ) {
+		SDL_FreeYUVOverlay(overlay);
+		SDL_OutOfMemory();
+		return(NULL);
+	}
+	SIXEL_InitYUVTables();
+
+	/* Find the pitch and offset values for the overlay */
+	overlay->pitches = hwdata->pitches;
+	overlay->pixels = hwdata->planes;
+	switch (format) {
+	    case SDL_YV12_OVERLAY:
+	    case SDL_IYUV_OVERLAY:
+		overlay->pitches[0] = overlay->w;
+		overlay->pitches[1] = overlay->pitches[0] / 2;
+		overlay->pitches[2] = overlay->pitches[0] / 2;
+		overlay->pixels[0] = hwdata->pixels;
+		overlay->pixels[1] = overlay->pixels[0] +
+		                     overlay->pitches[0] * overlay->h;
+		overlay->pixels[2] = overlay->pixels[1] +
+		                     overlay->pitches[1] * overlay->h / 2;
+		overlay->planes = 3;
+		break;
+	    default:
+		overlay->pitches[0] = overlay->w * 2;
+		overlay->pixels[0] = hwdata->pixels;
+		overlay->planes = 1;
+		break;
+	}
+	return(overlay);
+}
+
+int SIXEL_LockYUVOverlay(_THIS, SDL_Overlay *overlay)
+{
+	return(0);
+}
+
+void SIXEL_UnlockYUVOverlay(_THIS, SDL_Overlay *overlay)
+{
+	return;
+}
+
+int SIXEL_DisplayYUVOverlay(_THIS, SDL_Overlay *overlay, SDL_Rect *src, SDL_Rect *dst)
+{
+	struct private_yuvhwdata *hwdata = overlay->hwdata;
+	SDL_Surface *display = hwdata->display;
+	SDL_PixelFormat *format = display->format;
+	SDL_Palette *palette = format->palette;
+	const Uint8 *lum, *cb, *cr;
+	const Uint8 *lrow, *cbrow, *crrow;
+	int lstep, cstep, cpitch, cshift;
+	int bpp = format->BytesPerPixel;
+	int x, y, sx, sy, l, u, v, r, g, b;
+	int ro = 0, go = 1, bo = 2;
+	int *cols;
+	Uint8 *dstp;
+
+	switch (overlay->format) {
+	    case SDL_YV12_OVERLAY:
+		lum = overlay->pixels[0];
+		cr = overlay->pixels[1];
+		cb = overlay->pixels[2];
+		break;
+	    case SDL_IYUV_OVERLAY:
+		lum = overlay->pixels[0];
+		cb = overlay->pixels[1];
+		cr = overlay->pixels[2];
+		break;
+	    case SDL_YUY2_OVERLAY:
+		lum = overlay->pixels[0];
+		cb = lum + 1;
+		cr = lum + 3;
+		break;
+	    case SDL_UYVY_OVERLAY:
+		lum = overlay->pixels[0] + 1;
+		cb = lum - 1;
+		cr = lum + 1;
+		break;
+	    case SDL_YVYU_OVERLAY:
+		lum = overlay->pixels[0];
+		cr = lum + 1;
+		cb = lum + 3;
+		break;
+	    default:
+		SDL_SetError("Unsupported YUV format in blit");
+		return(-1);
+	}
+	if ( overlay->planes == 3 ) {
+		lstep = 1;
+		cstep = 1;
+		cpitch = overlay->pitches[1];
+		cshift = 1;
+	} else {
+		lstep = 2;
+		cstep = 4;
+		cpitch = overlay->pitches[0];
+		cshift = 0;
+	}
+
+	if ( bpp == 1 ) {
+		if ( hwdata->ncolors != palette->ncolors ||
+		     SDL_memcmp(hwdata->palette, palette->colors,
+		                palette->ncolors * sizeof(*palette->colors)) != 0 ) {
+			hwdata->ncolors = SDL_min(palette->ncolors, 256);
+			SDL_memcpy(hwdata->palette, palette->colors,
+			           hwdata->ncolors * sizeof(*palette->colors));
+			SDL_memset(hwdata->lut, 0xFF,
+			           SIXEL_YUV_LUT_SIZE * sizeof(*hwdata->lut));
+		}
+	} else if ( bpp == 3 ) {
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+		ro = format->Rshift / 8;
+		go = format->Gshift / 8;
+		bo = format->Bshift / 8;
+#else
+		ro = 2 - format->Rshift / 8;
+		go = 2 - format->Gshift / 8;
+		bo = 2 - format->Bshift / 8;
+#endif
+	}
+
+	/* The screen may have grown since the overlay was created */
+	if ( dst->w > hwdata->ncols ) {
+		cols = (int *)SDL_realloc(hwdata->cols, 2 * dst->w * sizeof(*cols));
+		if ( cols == NULL ) {
+			SDL_OutOfMemory();
+			return(-1);
+		}
+		hwdata->cols = cols;
+		hwdata->ncols = dst->w;
+	}
+	cols = hwdata->cols;
+
+	/* Sample at the middle of every screen pixel */
+	for ( x = 0; x < dst->w; ++x ) {
+		sx = src->x + ((2 * x + 1) * src->w) / (2 * dst->w);
+		cols[2 * x] = sx * lstep;
+		cols[2 * x + 1] = (sx >> 1) * cstep;
+	}
+
+	if ( SDL_MUSTLOCK(display) ) {
+		if ( SDL_LockSurface(display) < 0 ) {
+			return(-1);
+		}
+	}
+	for ( y = 0; y < dst->h; ++y ) {
+		sy = src->y + ((2 * y + 1) * src->h) / (2 * dst->h);
+		lrow = lum + sy * overlay->pitches[0];
+		cbrow = cb + (sy >> cshift) * cpitch;
+		crrow = cr + (sy >> cshift) * cpitch;
+		dstp = (Uint8 *)display->pixels + (dst->y + y) * display->pitch +
+		       dst->x * bpp;
+		for ( x = 0; x < dst->w; ++x, dstp += bpp ) {
+			l = lrow[cols[2 * x]];
+			u = cbrow[cols[2 * x + 1]];
+			v = crrow[cols[2 * x + 1]];
+			if ( bpp == 1 ) {
+				l = (l >> (8 - SIXEL_YUV_YBITS)) << (2 * SIXEL_YUV_CBITS) |
+				    (u >> (8 - SIXEL_YUV_CBITS)) << SIXEL_YUV_CBITS |
+				    (v >> (8 - SIXEL_YUV_CBITS));
+				if ( hwdata->lut[l] != SIXEL_YUV_UNSET ) {
+					*dstp = (Uint8)hwdata->lut[l];
+				} else {
+					*dstp = (Uint8)SIXEL_MatchYUV(hwdata, l);
+				}
+				continue;
+			}
+			l = sixel_y_tab[l];
+			r = SIXEL_Clamp(l + sixel_rv_tab[v]);
+			g = SIXEL_Clamp(l + sixel_gu_tab[u] + sixel_gv_tab[v]);
+			b = SIXEL_Clamp(l + sixel_bu_tab[u]);
+			if ( bpp == 4 ) {
+				*(Uint32 *)dstp = r << format->Rshift |
+				                  g << format->Gshift |
+				                  b << format->Bshift;
+			} else {
+				dstp[ro] = r;
+				dstp[go] = g;
+				dstp[bo] = b;
+			}
+		}
+	}
+	if ( SDL_MUSTLOCK(display) ) {
+		SDL_UnlockSurface(display);
+	}
+	SDL_UpdateRects(display, 1, dst);
+
+	return(0);
+}
+
+void SIXEL_FreeYUVOverlay(_THIS, SDL_Overlay *overlay)
+{
+	struct private_yuvhwdata *hwdata = overlay->hwdata;
+
+	if ( hwdata ) {
+		SDL_free(hwdata->pixels);
+		SDL_free(hwdata->cols);
+		SDL_free(hwdata->lut);
+		SDL_free(hwdata);
+	}
+}
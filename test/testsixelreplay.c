@@ -0,0 +1,271 @@
+/*
+ * testsixelreplay.c
+ *
+ * Replays a capture made by the sixel video driver with SDL_SIXEL_CAPTURE,
+ * without a terminal, and reports how fast the driver went through it.
+ *
+ * The terminal replies the driver waits for are fed to it through a pipe
+ * on standard input, and its output goes to /dev/null unless told
+ * otherwise, so the numbers only depend on the driver and the machine.
+ * The usual SDL_SIXEL_* variables apply to the replay as well.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "SDL.h"
+#include "SDL_sixel.h"
+
+static FILE *capture;
+static int replies = -1;
+static SDL_Surface *screen;
+static SDL_Rect *rects;
+static int maxrects;
+
+/* Call this instead of exit(), so we can clean up SDL: atexit() is evil. */
+static void quit(int rc)
+{
+	SDL_Quit();
+	exit(rc);
+}
+
+static int read_fields(Uint32 *fields, int n)
+{
+	return(fread(fields, sizeof(*fields), n, capture) == (size_t)n);
+}
+
+static void truncated(void)
+{
+	fprintf(stderr, "The capture is truncated\n");
+	quit(1);
+}
+
+static void replay_mode(void)
+{
+	Uint32 fields[3];
+
+	if ( ! read_fields(fields, 3) ) {
+		truncated();
+	}
+	screen = SDL_SetVideoMode(fields[0], fields[1], fields[2], SDL_SWSURFACE);
+	if ( screen == NULL ) {
+		fprintf(stderr, "Couldn't set %dx%dx%d video mode: %s\n",
+			fields[0], fields[1], fields[2], SDL_GetError());
+		quit(2);
+	}
+}
+
+static void replay_geometry(void)
+{
+	Uint32 fields[4];
+	char reply[64];
+	int len;
+
+	if ( ! read_fields(fields, 4) ) {
+		truncated();
+	}
+	/* Answer the size queries the way a terminal would */
+	len = sprintf(reply, "\033[4;%d;%dt\033[8;%d;%dt",
+		fields[1], fields[0], fields[3], fields[2]);
+	if ( write(replies, reply, len) != len ) {
+		fprintf(stderr, "Couldn't send the terminal size\n");
+		quit(1);
+	}
+	SDL_PumpEvents();
+}
+
+static void replay_palette(void)
+{
+	Uint32 fields[2];
+	SDL_Color colors[256];
+	Uint8 rgb[3];
+	int i;
+
+	if ( ! read_fields(fields, 2) ||
+	     fields[1] > 256 || fields[0] > 256 - fields[1] ) {
+		truncated();
+	}
+	for ( i = 0; i < (int)fields[1]; ++i ) {
+		if ( fread(rgb, 1, 3, capture) != 3 ) {
+			truncated();
+		}
+		colors[i].r = rgb[0];
+		colors[i].g = rgb[1];
+		colors[i].b = rgb[2];
+	}
+	SDL_SetColors(screen, colors, fields[0], fields[1]);
+}
+
+static void replay_frame(void)
+{
+	Uint32 fields[4];
+	int i, y, numrects;
+	int bpp;
+	Uint8 *row;
+
+	if ( ! read_fields(fields, 3) ) {
+		truncated();
+	}
+	numrects = fields[2];
+	if ( screen == NULL ) {
+		fprintf(stderr, "The capture is corrupt\n");
+		quit(1);
+	}
+	if ( numrects > maxrects ) {
+		rects = (SDL_Rect *)realloc(rects, numrects * sizeof(*rects));
+		if ( rects == NULL ) {
+			fprintf(stderr, "Out of memory\n");
+			quit(1);
+		}
+		maxrects = numrects;
+	}
+	for ( i = 0; i < numrects; ++i ) {
+		/* Written so that a corrupt size can't wrap around */
+		if ( ! read_fields(fields, 4) ||
+		     fields[2] > (Uint32)screen->w ||
+		     fields[0] > (Uint32)screen->w - fields[2] ||
+		     fields[3] > (Uint32)screen->h ||
+		     fields[1] > (Uint32)screen->h - fields[3] ) {
+			truncated();
+		}
+		rects[i].x = fields[0];
+		rects[i].y = fields[1];
+		rects[i].w = fields[2];
+		rects[i].h = fields[3];
+	}
+	bpp = screen->format->BytesPerPixel;
+	for ( i = 0; i < numrects; ++i ) {
+		for ( y = rects[i].y; y < rects[i].y + rects[i].h; ++y ) {
+			row = (Uint8 *)screen->pixels + y * screen->pitch + rects[i].x * bpp;
+			if ( fread(row, bpp, rects[i].w, capture) != rects[i].w ) {
+				truncated();
+			}
+		}
+	}
+	SDL_UpdateRects(screen, numrects, rects);
+	SDL_PumpEvents();
+}
+
+static int replay(void)
+{
+	char magic[8];
+	int type, frames = 0;
+
+	if ( fread(magic, 1, 8, capture) != 8 || memcmp(magic, "SIXELCAP", 8) != 0 ) {
+		fprintf(stderr, "Not a sixel capture\n");
+		quit(1);
+	}
+	while ( (type = fgetc(capture)) != EOF ) {
+		switch (type) {
+		case 'M':
+			replay_mode();
+			break;
+		case 'G':
+			replay_geometry();
+			break;
+		case 'P':
+			replay_palette();
+			break;
+		case 'F':
+			replay_frame();
+			++frames;
+			break;
+		default:
+			fprintf(stderr, "Unknown record '%c' in the capture\n", type);
+			quit(1);
+		}
+	}
+	return(frames);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *output = "/dev/null";
+	const char *file = NULL;
+	int i, fd, loops = 1;
+	int pipefd[2];
+	int frames;
+	Uint32 then, now;
+	SDL_SixelStats stats;
+
+	for ( i = 1; i < argc; ++i ) {
+		if ( strcmp(argv[i], "-o") == 0 && argv[i+1] ) {
+			output = argv[++i];
+		} else if ( strcmp(argv[i], "-loops") == 0 && argv[i+1] ) {
+			loops = atoi(argv[++i]);
+		} else if ( argv[i][0] != '-' ) {
+			file = argv[i];
+		} else {
+			file = NULL;
+			break;
+		}
+	}
+	if ( file == NULL || loops < 1 ) {
+		fprintf(stderr, "Usage: %s [-o output] [-loops n] capture\n", argv[0]);
+		return(1);
+	}
+	capture = fopen(file, "rb");
+	if ( capture == NULL ) {
+		fprintf(stderr, "Couldn't open %s\n", file);
+		return(1);
+	}
+
+	/* Stand in for the terminal on both ends */
+	fd = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if ( fd < 0 || pipe(pipefd) < 0 ) {
+		fprintf(stderr, "Couldn't set up the output to %s\n", output);
+		return(1);
+	}
+	dup2(fd, STDOUT_FILENO);
+	dup2(pipefd[0], STDIN_FILENO);
+	close(fd);
+	close(pipefd[0]);
+	replies = pipefd[1];
+
+	/* Have the replies read as soon as events are pumped */
+	putenv("SDL_VIDEODRIVER=sixel");
+	putenv("SDL_SIXEL_INPUT_THREAD=0");
+	if ( SDL_Init(SDL_INIT_VIDEO) < 0 ) {
+		fprintf(stderr, "Couldn't initialize SDL: %s\n", SDL_GetError());
+		return(1);
+	}
+
+	frames = 0;
+	then = SDL_GetTicks();
+	for ( i = 0; i < loops; ++i ) {
+		rewind(capture);
+		frames += replay();
+	}
+	now = SDL_GetTicks();
+	if ( SDL_SixelGetStats(&stats) < 0 ) {
+		fprintf(stderr, "%s\n", SDL_GetError());
+		quit(2);
+	}
+	if ( now == then ) {
+		now = then + 1;
+	}
+
+	fprintf(stderr, "%d frames in %.2f seconds, %.2f frames/s\n",
+		frames, (now - then) / 1000.0, frames * 1000.0 / (now - then));
+	if ( stats.frames > 0 ) {
+		/* Setting the video mode resets the counters */
+		fprintf(stderr, "Last pass: %u frames encoded, %u dropped, %u bytes/frame\n",
+			stats.frames, stats.frames_dropped,
+			(Uint32)(stats.bytes / stats.frames));
+		fprintf(stderr, "copy %.2f, scale %.2f, diff %.2f, quantize %.2f, "
+			"encode %.2f, write %.2f ms/frame\n",
+			stats.copy_us / 1000.0 / stats.frames,
+			stats.scale_us / 1000.0 / stats.frames,
+			stats.diff_us / 1000.0 / stats.frames,
+			stats.quantize_us / 1000.0 / stats.frames,
+			stats.encode_us / 1000.0 / stats.frames,
+			stats.write_us / 1000.0 / stats.frames);
+	}
+	fclose(capture);
+	free(rects);
+	SDL_Quit();
+	return(0);
+}
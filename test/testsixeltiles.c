@@ -0,0 +1,298 @@
+/*
+ * testsixeltiles.c
+ *
+ * Checks that the sixel video driver shows the same picture whether the
+ * screen is sent whole or in rectangles of different widths, which is
+ * only the case if every rectangle goes through the same encoder.
+ *
+ * Like testsixelreplay it runs without a terminal: the size replies come
+ * through a pipe on standard input, and the output goes to a temporary
+ * file, which is then decoded and compared pixel by pixel.  The usual
+ * SDL_SIXEL_* variables apply, try it with SDL_SIXEL_ENCODER=builtin too.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "SDL.h"
+
+#define WIDTH	320
+#define HEIGHT	192
+#define CELL_W	8
+#define CELL_H	16
+
+typedef struct {
+	Uint8 set[WIDTH * HEIGHT];
+	Uint8 rgb[WIDTH * HEIGHT * 3];
+	int images;
+	int partial;
+} canvas_t;
+
+static SDL_Surface *screen;
+static int output;
+static canvas_t tiled, whole;
+
+/* Call this instead of exit(), so we can clean up SDL: atexit() is evil. */
+static void quit(int rc)
+{
+	SDL_Quit();
+	exit(rc);
+}
+
+/* Draw one of two patterns over part of the screen, never black so that
+   every cell changes when the screen is cleared */
+static void draw(int pattern, int x1, int y1, int x2, int y2)
+{
+	SDL_Rect rect;
+	int x, y, r, g, b;
+
+	rect.w = 1;
+	rect.h = 1;
+	for ( y = y1; y < y2; ++y ) {
+		for ( x = x1; x < x2; ++x ) {
+			r = 16 + x * 239 / WIDTH;
+			g = 16 + y * 239 / HEIGHT;
+			b = 16 + ((x * y) & 0xdf);
+			if ( pattern ) {
+				r = 271 - r;
+				b = 271 - b;
+			}
+			rect.x = x;
+			rect.y = y;
+			SDL_FillRect(screen, &rect, SDL_MapRGB(screen->format, r, g, b));
+		}
+	}
+}
+
+static off_t where(void)
+{
+	return(lseek(output, 0, SEEK_CUR));
+}
+
+static int number(const Uint8 *data, off_t *pos, off_t end)
+{
+	int value = 0;
+
+	while ( *pos < end && data[*pos] >= '0' && data[*pos] <= '9' ) {
+		value = value * 10 + (data[(*pos)++] - '0');
+	}
+	return(value);
+}
+
+/* Paint the sixel images sent between two offsets of the output */
+static void decode(const Uint8 *data, off_t pos, off_t end, canvas_t *canvas)
+{
+	int params[5];
+	int nparams;
+	int colors[256][3];
+	int color = 0;
+	int ox = 0, oy = 0, x, y, w = 0, h = 0;
+	int repeat, bit, px, py, c;
+
+	memset(colors, 0, sizeof(colors));
+	while ( pos < end ) {
+		if ( data[pos] != '\033' || pos + 1 >= end ) {
+			++pos;
+			continue;
+		}
+		pos += 2;
+		if ( data[pos-1] == '[' ) {
+			/* Only cursor positioning matters */
+			nparams = 0;
+			while ( pos < end && nparams < 5 ) {
+				params[nparams++] = number(data, &pos, end);
+				if ( pos >= end || data[pos] != ';' ) {
+					break;
+				}
+				++pos;
+			}
+			while ( pos < end && (data[pos] < 0x40 || data[pos] > 0x7e) ) {
+				++pos;
+			}
+			if ( pos < end && data[pos] == 'H' && nparams == 2 ) {
+				oy = (params[0] - 1) * CELL_H;
+				ox = (params[1] - 1) * CELL_W;
+			}
+			continue;
+		}
+		if ( data[pos-1] != 'P' ) {
+			continue;
+		}
+		while ( pos < end && data[pos] != 'q' ) {
+			++pos;
+		}
+		++pos;
+		++canvas->images;
+		x = 0;
+		y = 0;
+		w = WIDTH;
+		h = HEIGHT;
+		while ( pos < end && data[pos] != '\033' ) {
+			c = data[pos++];
+			repeat = 1;
+			if ( c == '"' ) {
+				for ( nparams = 0; nparams < 4; ++nparams ) {
+					params[nparams] = number(data, &pos, end);
+					if ( pos < end && data[pos] == ';' ) {
+						++pos;
+					}
+				}
+				w = params[2];
+				h = params[3];
+				if ( ox != 0 || w != WIDTH ) {
+					++canvas->partial;
+				}
+				continue;
+			}
+			if ( c == '#' ) {
+				nparams = 0;
+				do {
+					params[nparams++] = number(data, &pos, end);
+				} while ( nparams < 5 && pos < end && data[pos] == ';' && ++pos );
+				color = params[0] & 0xff;
+				if ( nparams == 5 ) {
+					colors[color][0] = params[2];
+					colors[color][1] = params[3];
+					colors[color][2] = params[4];
+				}
+				continue;
+			}
+			if ( c == '!' ) {
+				repeat = number(data, &pos, end);
+				c = data[pos++];
+			}
+			if ( c == '$' ) {
+				x = 0;
+				continue;
+			}
+			if ( c == '-' ) {
+				x = 0;
+				y += 6;
+				continue;
+			}
+			if ( c < '?' || c > '~' ) {
+				continue;
+			}
+			for ( ; repeat > 0; --repeat, ++x ) {
+				for ( bit = 0; bit < 6; ++bit ) {
+					px = ox + x;
+					py = oy + y + bit;
+					if ( ! ((c - '?') & (1 << bit)) || x >= w ||
+					     y + bit >= h || px >= WIDTH || py >= HEIGHT ) {
+						continue;
+					}
+					canvas->set[py * WIDTH + px] = 1;
+					canvas->rgb[(py * WIDTH + px) * 3 + 0] = colors[color][0];
+					canvas->rgb[(py * WIDTH + px) * 3 + 1] = colors[color][1];
+					canvas->rgb[(py * WIDTH + px) * 3 + 2] = colors[color][2];
+				}
+			}
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	static const SDL_Rect tiles[] = {
+		{ 8, 16, 96, 48 }, { 200, 16, 104, 48 },
+		{ 40, 80, 240, 32 }, { 16, 128, 48, 48 }, { 96, 144, 216, 32 }
+	};
+	const int ntiles = sizeof(tiles) / sizeof(tiles[0]);
+	SDL_Rect rects[sizeof(tiles) / sizeof(tiles[0])];
+	char reply[64];
+	int pipefd[2];
+	FILE *file;
+	Uint8 *data;
+	off_t start, middle, blank, end;
+	int i, len, unset, mismatches;
+
+	/* Stand in for the terminal on both ends */
+	file = tmpfile();
+	if ( file == NULL || pipe(pipefd) < 0 ) {
+		fprintf(stderr, "Couldn't set up the output\n");
+		return(1);
+	}
+	output = fileno(file);
+	dup2(output, STDOUT_FILENO);
+	dup2(pipefd[0], STDIN_FILENO);
+	close(pipefd[0]);
+
+	putenv("SDL_VIDEODRIVER=sixel");
+	putenv("SDL_SIXEL_INPUT_THREAD=0");
+	putenv("SDL_SIXEL_ASYNC=0");
+	if ( SDL_Init(SDL_INIT_VIDEO) < 0 ) {
+		fprintf(stderr, "Couldn't initialize SDL: %s\n", SDL_GetError());
+		return(1);
+	}
+	screen = SDL_SetVideoMode(WIDTH, HEIGHT, 24, SDL_SWSURFACE);
+	if ( screen == NULL ) {
+		fprintf(stderr, "Couldn't set %dx%dx24 video mode: %s\n",
+			WIDTH, HEIGHT, SDL_GetError());
+		quit(2);
+	}
+	SDL_ShowCursor(SDL_DISABLE);
+
+	/* A terminal as large as the screen, so nothing gets scaled */
+	len = sprintf(reply, "\033[4;%d;%dt\033[8;%d;%dt",
+		HEIGHT, WIDTH, HEIGHT / CELL_H, WIDTH / CELL_W);
+	if ( write(pipefd[1], reply, len) != len ) {
+		fprintf(stderr, "Couldn't send the terminal size\n");
+		quit(2);
+	}
+	SDL_PumpEvents();
+
+	/* The first pattern whole, then the second one piece by piece */
+	start = where();
+	draw(0, 0, 0, WIDTH, HEIGHT);
+	SDL_UpdateRect(screen, 0, 0, 0, 0);
+	for ( i = 0; i < ntiles; ++i ) {
+		draw(1, tiles[i].x, tiles[i].y,
+		     tiles[i].x + tiles[i].w, tiles[i].y + tiles[i].h);
+	}
+	/* The driver may change the rectangles it is given */
+	memcpy(rects, tiles, sizeof(tiles));
+	SDL_UpdateRects(screen, ntiles, rects);
+	middle = where();
+
+	/* The same picture whole, after a blank screen */
+	SDL_FillRect(screen, NULL, 0);
+	SDL_UpdateRect(screen, 0, 0, 0, 0);
+	blank = where();
+	draw(0, 0, 0, WIDTH, HEIGHT);
+	for ( i = 0; i < ntiles; ++i ) {
+		draw(1, tiles[i].x, tiles[i].y,
+		     tiles[i].x + tiles[i].w, tiles[i].y + tiles[i].h);
+	}
+	SDL_UpdateRect(screen, 0, 0, 0, 0);
+	end = where();
+
+	data = (Uint8 *)malloc(end);
+	if ( data == NULL || pread(output, data, end, 0) != end ) {
+		fprintf(stderr, "Couldn't read the output back\n");
+		quit(2);
+	}
+	decode(data, start, middle, &tiled);
+	decode(data, blank, end, &whole);
+	free(data);
+
+	unset = 0;
+	mismatches = 0;
+	for ( i = 0; i < WIDTH * HEIGHT; ++i ) {
+		if ( ! tiled.set[i] || ! whole.set[i] ) {
+			++unset;
+		} else if ( memcmp(&tiled.rgb[i * 3], &whole.rgb[i * 3], 3) != 0 ) {
+			++mismatches;
+		}
+	}
+	fprintf(stderr, "%d images, %d partial: %d pixels missing, %d differ\n",
+		tiled.images, tiled.partial, unset, mismatches);
+	SDL_Quit();
+
+	if ( tiled.partial == 0 ) {
+		fprintf(stderr, "The update wasn't split, nothing was compared\n");
+		return(1);
+	}
+	return((unset || mismatches) ? 1 : 0);
+}